@@ -51,7 +51,12 @@
 #include <string.h>
 #include <math.h>
 #include <sys/prctl.h>
+#include <sys/eventfd.h>
 #include <sched.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
 
 #include <libintl.h>
 #define _(str) gettext(str)             ///< gettext shortcut
@@ -92,6 +97,17 @@
 #endif
 #endif
 
+#ifdef USE_AUDIO_MIXER
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_AUDIO_MIXER_X86             ///< use x86 SIMD mixer kernels
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define USE_AUDIO_MIXER_NEON            ///< use NEON mixer kernel
+#include <arm_neon.h>
+#endif
+#endif
+
 #include "iatomic.h"                    // portable atomic_t
 
 #include "ringbuffer.h"
@@ -146,7 +162,20 @@ static volatile char AudioVideoIsReady; ///< video ready start early
 static int AudioSkip;                   ///< skip audio to sync to video
 int AudioDelay;                         /// delay audio to sync to video
 
-static const int AudioBytesProSample = 2;   ///< number of bytes per sample
+static const int AudioBytesProSample = 2;   ///< number of bytes per int16 sample
+
+/**
+**	Hardware sample formats.
+*/
+enum _audio_format_
+{
+    AudioFormatS16,                     ///< signed 16 bit
+    AudioFormatS32,                     ///< signed 32 bit
+    AudioFormatFloat,                   ///< 32 bit float
+};
+
+static char AudioFloat;                 ///< flag use float pipeline
+static char AudioHwFormat;              ///< best pcm sample format of hw
 
 static int AudioBufferTime = 336;       ///< audio buffer time in ms
 
@@ -164,6 +193,8 @@ static char AudioNormalize;             ///< flag use volume normalize
 static char AudioCompression;           ///< flag use compress volume
 static char AudioMute;                  ///< flag muted
 static int AudioAmplifier;              ///< software volume factor
+static float AudioSoftGain = 1.0f;      ///< software volume gain applied
+static const int AudioVolumeRamp = 20;  ///< software volume ramp in ms
 static int AudioNormalizeFactor;        ///< current normalize factor
 static const int AudioMinNormalize = 100;   ///< min. normalize factor
 static int AudioMaxNormalize;           ///< max. normalize factor
@@ -171,11 +202,21 @@ static int AudioCompressionFactor;      ///< current compression factor
 static int AudioMaxCompression;         ///< max. compression factor
 static int AudioStereoDescent;          ///< volume descent for stereo
 static int AudioVolume;                 ///< current volume (0 .. 1000)
+static int AudioPackets;                ///< statistic packets enqueued
+static int AudioCopies;                 ///< statistic extra sample copies
+static uint32_t AudioFlushTime;         ///< time of last flush in ms
+static int AudioStartLatency;           ///< statistic flush to play start in ms
+
+    /// samples converted at once, when input and ring format differ
+#define AUDIO_CHUNK_SAMPLES (8 * 1024)
+
+    /// frames mixed with the same software volume, while it ramps
+#define AUDIO_RAMP_FRAMES 32
 
 extern int VideoAudioDelay;             ///< import audio/video delay
 
-/// default ring buffer size ~2s 8ch 16bit (3 * 5 * 7 * 8)
-static const unsigned AudioRingBufferSize = 3 * 5 * 7 * 8 * 2 * 1000;
+/// default ring buffer size ~2s 8ch 32bit (3 * 5 * 7 * 8)
+static const unsigned AudioRingBufferSize = 3 * 5 * 7 * 8 * 4 * 1000;
 
 static int AudioChannelsInHw[9];        ///< table which channels are supported
 enum _audio_rates
@@ -215,6 +256,49 @@ static int AudioNormIndex;              ///< index into average table
 static int AudioNormReady;              ///< index counter
 static int AudioNormCounter;            ///< sample counter
 
+/**
+**	Update normalize factor, if a sample block is complete.
+*/
+static void AudioNormalizerUpdate(void)
+{
+    int i;
+    uint32_t avg;
+    int factor;
+
+    if (AudioNormCounter < AudioNormSamples) {
+        return;
+    }
+    if (AudioNormReady < AudioNormMaxIndex) {
+        AudioNormReady++;
+    } else {
+        avg = 0;
+        for (i = 0; i < AudioNormMaxIndex; ++i) {
+            avg += AudioNormAverage[i] / AudioNormMaxIndex;
+        }
+
+        // calculate normalize factor
+        if (avg > 0) {
+            factor = ((INT16_MAX / 8) * 1000U) / (uint32_t) sqrt(avg);
+            // smooth normalize
+            AudioNormalizeFactor = (AudioNormalizeFactor * 500 + factor * 500) / 1000;
+            if (AudioNormalizeFactor < AudioMinNormalize) {
+                AudioNormalizeFactor = AudioMinNormalize;
+            }
+            if (AudioNormalizeFactor > AudioMaxNormalize) {
+                AudioNormalizeFactor = AudioMaxNormalize;
+            }
+        } else {
+            factor = 1000;
+        }
+        Debug(4, "audio/noramlize: avg %8d, fac=%6.3f, norm=%6.3f\n", avg, factor / 1000.0,
+            AudioNormalizeFactor / 1000.0);
+    }
+
+    AudioNormIndex = (AudioNormIndex + 1) % AudioNormMaxIndex;
+    AudioNormCounter = 0;
+    AudioNormAverage[AudioNormIndex] = 0U;
+}
+
 /**
 **	Audio normalizer.
 **
@@ -227,7 +311,6 @@ static void AudioNormalizer(int16_t * samples, int count)
     int l;
     int n;
     uint32_t avg;
-    int factor;
     int16_t *data;
 
     // average samples
@@ -247,37 +330,7 @@ static void AudioNormalizer(int16_t * samples, int count)
         }
         AudioNormAverage[AudioNormIndex] = avg;
         AudioNormCounter += n;
-        if (AudioNormCounter >= AudioNormSamples) {
-            if (AudioNormReady < AudioNormMaxIndex) {
-                AudioNormReady++;
-            } else {
-                avg = 0;
-                for (i = 0; i < AudioNormMaxIndex; ++i) {
-                    avg += AudioNormAverage[i] / AudioNormMaxIndex;
-                }
-
-                // calculate normalize factor
-                if (avg > 0) {
-                    factor = ((INT16_MAX / 8) * 1000U) / (uint32_t) sqrt(avg);
-                    // smooth normalize
-                    AudioNormalizeFactor = (AudioNormalizeFactor * 500 + factor * 500) / 1000;
-                    if (AudioNormalizeFactor < AudioMinNormalize) {
-                        AudioNormalizeFactor = AudioMinNormalize;
-                    }
-                    if (AudioNormalizeFactor > AudioMaxNormalize) {
-                        AudioNormalizeFactor = AudioMaxNormalize;
-                    }
-                } else {
-                    factor = 1000;
-                }
-                Debug(4, "audio/noramlize: avg %8d, fac=%6.3f, norm=%6.3f\n", avg, factor / 1000.0,
-                    AudioNormalizeFactor / 1000.0);
-            }
-
-            AudioNormIndex = (AudioNormIndex + 1) % AudioNormMaxIndex;
-            AudioNormCounter = 0;
-            AudioNormAverage[AudioNormIndex] = 0U;
-        }
+        AudioNormalizerUpdate();
         data += n;
         l -= n;
     } while (l > 0);
@@ -296,6 +349,48 @@ static void AudioNormalizer(int16_t * samples, int count)
     }
 }
 
+/**
+**	Audio normalizer for float samples.
+**
+**	Only the normalize factor is updated, the mixer applies it.
+**
+**	@param samples	sample buffer
+**	@param count	number of samples in sample buffer
+**	@param scale	gain applied before normalize
+**
+**	@returns normalize gain.
+*/
+static float AudioNormalizerFloat(const float *samples, int count, float scale)
+{
+    int i;
+    int n;
+
+    // average table is shared with the int16 normalizer
+    scale *= INT16_MAX;
+    do {
+        float avg;
+
+        n = count;
+        if (AudioNormCounter + n > AudioNormSamples) {
+            n = AudioNormSamples - AudioNormCounter;
+        }
+        avg = 0.0f;
+        for (i = 0; i < n; ++i) {
+            float t;
+
+            t = samples[i] * scale;
+            avg += t * t;
+        }
+        AudioNormAverage[AudioNormIndex] += avg / AudioNormSamples;
+        AudioNormCounter += n;
+        AudioNormalizerUpdate();
+        samples += n;
+        count -= n;
+    } while (count > 0);
+
+    return AudioNormalizeFactor / 1000.0f;
+}
+
 /**
 **	Reset normalizer.
 */
@@ -311,6 +406,29 @@ static void AudioResetNormalizer(void)
     AudioNormalizeFactor = 1000;
 }
 
+/**
+**	Update compression factor.
+**
+**	@param max_sample	loudest sample in int16 range
+*/
+static void AudioCompressorUpdate(int max_sample)
+{
+    int factor;
+
+    factor = (INT16_MAX * 1000) / max_sample;
+    // smooth compression (FIXME: make configurable?)
+    AudioCompressionFactor = (AudioCompressionFactor * 950 + factor * 50) / 1000;
+    if (AudioCompressionFactor > factor) {
+        AudioCompressionFactor = factor;    // no clipping
+    }
+    if (AudioCompressionFactor > AudioMaxCompression) {
+        AudioCompressionFactor = AudioMaxCompression;
+    }
+
+    Debug(4, "audio/compress: max %5d, fac=%6.3f, com=%6.3f\n", max_sample, factor / 1000.0,
+        AudioCompressionFactor / 1000.0);
+}
+
 /**
 **	Audio compression.
 **
@@ -321,7 +439,6 @@ static void AudioCompressor(int16_t * samples, int count)
 {
     int max_sample;
     int i;
-    int factor;
 
     // find loudest sample
     max_sample = 0;
@@ -336,22 +453,11 @@ static void AudioCompressor(int16_t * samples, int count)
 
     // calculate compression factor
     if (max_sample > 0) {
-        factor = (INT16_MAX * 1000) / max_sample;
-        // smooth compression (FIXME: make configurable?)
-        AudioCompressionFactor = (AudioCompressionFactor * 950 + factor * 50) / 1000;
-        if (AudioCompressionFactor > factor) {
-            AudioCompressionFactor = factor;    // no clipping
-        }
-        if (AudioCompressionFactor > AudioMaxCompression) {
-            AudioCompressionFactor = AudioMaxCompression;
-        }
+        AudioCompressorUpdate(max_sample);
     } else {
         return;                         // silent nothing todo
     }
 
-    Debug(4, "audio/compress: max %5d, fac=%6.3f, com=%6.3f\n", max_sample, factor / 1000.0,
-        AudioCompressionFactor / 1000.0);
-
     // apply compression factor
     for (i = 0; i < count / AudioBytesProSample; ++i) {
         int t;
@@ -366,6 +472,42 @@ static void AudioCompressor(int16_t * samples, int count)
     }
 }
 
+/**
+**	Audio compression for float samples.
+**
+**	Only the compression factor is updated, the mixer applies it.
+**	Float samples can exceed full scale, they are compressed back.
+**
+**	@param samples	sample buffer
+**	@param count	number of samples in sample buffer
+**
+**	@returns compression gain.
+*/
+static float AudioCompressorFloat(const float *samples, int count)
+{
+    float peak;
+    int i;
+
+    // find loudest sample
+    peak = 0.0f;
+    for (i = 0; i < count; ++i) {
+        float t;
+
+        t = fabsf(samples[i]);
+        if (t > peak) {
+            peak = t;
+        }
+    }
+    if (peak > 16.0f) {                 // broken stream, keep factor sane
+        peak = 16.0f;
+    }
+    if (peak * INT16_MAX >= 1.0f) {     // silent nothing todo
+        AudioCompressorUpdate(peak * INT16_MAX);
+    }
+
+    return AudioCompressionFactor / 1000.0f;
+}
+
 /**
 **	Reset compressor.
 */
@@ -377,189 +519,634 @@ static void AudioResetCompressor(void)
     }
 }
 
+/**
+**	Soft volume gain the samples should reach.
+**
+**	Mute is always done in software, the volume only with soft volume
+**	enabled.
+*/
+static float AudioSoftTarget(void)
+{
+    if (AudioMute) {
+        return 0.0f;
+    }
+    if (AudioSoftVolume) {
+        return AudioAmplifier / 1000.0f;
+    }
+    return 1.0f;
+}
+
+/**
+**	Step the soft volume gain towards its target.
+**
+**	@param frames	number of frames the gain is applied to
+**	@param rate	sample rate
+**
+**	@returns gain for the next frames
+*/
+static float AudioSoftRamp(int frames, int rate)
+{
+    float target;
+    float step;
+
+    target = AudioSoftTarget();
+    step = (float)frames * 1000 / (AudioVolumeRamp * rate);
+    if (AudioSoftGain < target - step) {
+        AudioSoftGain += step;
+    } else if (AudioSoftGain > target + step) {
+        AudioSoftGain -= step;
+    } else {
+        AudioSoftGain = target;
+    }
+    return AudioSoftGain;
+}
+
 /**
 **	Audio software amplifier.
 **
+**	Gain changes are ramped to avoid clicks.
+**
 **	@param samples	sample buffer
-**	@param count	number of bytes in sample buffer
+**	@param frames	number of frames in sample buffer
+**	@param channels	number of channels per frame
+**	@param rate	sample rate
 **
 **	@todo FIXME: this does hard clipping
 */
-static void AudioSoftAmplifier(int16_t * samples, int count)
+static void AudioSoftAmplifier(int16_t * samples, int frames, int channels, int rate)
 {
+    float target;
+    int amplifier;
     int i;
+    int c;
 
-    // silence
-    if (AudioMute || !AudioAmplifier) {
-        memset(samples, 0, count);
-        return;
+    target = AudioSoftTarget();
+    if (AudioSoftGain == target) {
+        if (target == 1.0f) {           // unity gain
+            return;
+        }
+        if (!target) {                  // silence
+            memset(samples, 0, frames * channels * AudioBytesProSample);
+            return;
+        }
     }
 
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-        int t;
+    amplifier = lrintf(AudioSoftGain * 1000);
+    for (i = 0; i < frames; ++i) {
+        if (AudioSoftGain != target) {  // step gain only while ramping
+            amplifier = lrintf(AudioSoftRamp(1, rate) * 1000);
+        }
+        for (c = 0; c < channels; ++c) {
+            int t;
 
-        t = (samples[i] * AudioAmplifier) / 1000;
-        if (t < INT16_MIN) {
-            t = INT16_MIN;
-        } else if (t > INT16_MAX) {
-            t = INT16_MAX;
+            t = (samples[c] * amplifier) / 1000;
+            if (t < INT16_MIN) {
+                t = INT16_MIN;
+            } else if (t > INT16_MAX) {
+                t = INT16_MAX;
+            }
+            samples[c] = t;
         }
-        samples[i] = t;
+        samples += channels;
     }
 }
 
 #ifdef USE_AUDIO_MIXER
 
 /**
-**	Upmix mono to stereo.
+**	Speaker positions of the audio mixer.
+*/
+enum _audio_speaker_
+{
+    AudioFL,                            ///< front left
+    AudioFR,                            ///< front right
+    AudioSL,                            ///< surround left
+    AudioSR,                            ///< surround right
+    AudioFC,                            ///< front center
+    AudioLFE,                           ///< low frequency effects
+    AudioBL,                            ///< back left
+    AudioBR,                            ///< back right
+};
+
+/**
+**	Speakers of the alsa channel order for 1 - 8 channels.
+**
+**	ffmpeg L  R  C	Ls Rs		-> alsa L R  Ls Rs C
+**	ffmpeg L  R  C	LFE Ls Rs	-> alsa L R  Ls Rs C  LFE
+**	ffmpeg L  R  C	LFE Ls Rs Rl Rr	-> alsa L R  Ls Rs C  LFE Rl Rr
+*/
+static const signed char AudioSpeakers[9][8] = {
+    {-1},
+    {AudioFC},
+    {AudioFL, AudioFR},
+    {AudioFL, AudioFR, AudioFC},
+    {AudioFL, AudioFR, AudioSL, AudioSR},
+    {AudioFL, AudioFR, AudioSL, AudioSR, AudioFC},
+    {AudioFL, AudioFR, AudioSL, AudioSR, AudioFC, AudioLFE},
+    {AudioFL, AudioFR, AudioSL, AudioSR, AudioFC, AudioBL, AudioBR},
+    {AudioFL, AudioFR, AudioSL, AudioSR, AudioFC, AudioLFE, AudioBL, AudioBR},
+};
+
+/**
+**	Downmix law entry, where a speaker missing in the output goes.
+*/
+typedef struct _audio_downmix_
+{
+    signed char Speaker;                ///< speaker missing in output, -1 any
+    signed char To[2];                  ///< destination speakers, -1 unused
+    float Gain;                         ///< gain to each destination
+} AudioDownmix;
+
+/**
+**	Downmix law, the first entry with all destinations in the output is
+**	used.  Rows of the mix matrix are scaled down afterwards, so that
+**	the mix can't clip.
+*/
+static const AudioDownmix AudioDownmixLaw[] = {
+    {AudioFC, {AudioFL, AudioFR}, 0.7071f}, // -3dB
+    {AudioSL, {AudioFL, -1}, 0.7071f},
+    {AudioSR, {AudioFR, -1}, 0.7071f},
+    {AudioBL, {AudioSL, -1}, 1.0f},
+    {AudioBR, {AudioSR, -1}, 1.0f},
+    {AudioBL, {AudioFL, -1}, 0.5f},
+    {AudioBR, {AudioFR, -1}, 0.5f},
+    {AudioLFE, {AudioFL, AudioFR}, 0.35f},
+    {-1, {AudioFC, -1}, 0.7071f},       // mono
+};
+
+    /// mix matrix Q15 [in channels][out channels][out channel][in channel]
+static int16_t AudioMixMatrix[9][9][8][8] __attribute__ ((aligned(16)));
+
+    /// mix kernel selected for the cpu
+static void (*AudioMixKernel)(const int16_t *, int, int, int16_t *, int, const int16_t (*)[8]);
+
+    /// mix gains [in channels][out channels][in channel][out channel]
+static float AudioMixGain[9][9][8][8] __attribute__ ((aligned(16)));
+
+    /// float mix kernel selected for the cpu
+static void (*AudioMixFloatKernel)(const float *, int, int, void *, int, const float (*)[8], int);
+
+/**
+**	Build mix matrix for @a in_chan to @a out_chan channels.
+**
+**	@param in_chan	nr. of input channels
+**	@param out_chan	nr. of output channels
+*/
+static void AudioMixMatrixBuild(int in_chan, int out_chan)
+{
+    float gain[8][8];
+    int out_of[8];
+    int i;
+    int o;
+
+    memset(gain, 0, sizeof(gain));
+    for (i = 0; i < 8; ++i) {           // output channel of speaker
+        out_of[i] = -1;
+    }
+    for (o = 0; o < out_chan; ++o) {
+        out_of[(int)AudioSpeakers[out_chan][o]] = o;
+    }
+
+    for (i = 0; i < in_chan; ++i) {
+        const AudioDownmix *law;
+        int speaker;
+
+        speaker = AudioSpeakers[in_chan][i];
+        if (out_of[speaker] >= 0) {     // output has the speaker
+            gain[out_of[speaker]][i] = 1.0f;
+            continue;
+        }
+        for (law = AudioDownmixLaw; law < AudioDownmixLaw + sizeof(AudioDownmixLaw) / sizeof(*AudioDownmixLaw);
+            ++law) {
+            if ((law->Speaker != -1 && law->Speaker != speaker) || out_of[(int)law->To[0]] < 0 || (law->To[1] != -1
+                    && out_of[(int)law->To[1]] < 0)) {
+                continue;
+            }
+            // mono input is played at full level on both fronts
+            gain[out_of[(int)law->To[0]]][i] = in_chan == 1 ? 1.0f : law->Gain;
+            if (law->To[1] != -1) {
+                gain[out_of[(int)law->To[1]]][i] = in_chan == 1 ? 1.0f : law->Gain;
+            }
+            break;
+        }
+    }
+
+    for (o = 0; o < out_chan; ++o) {
+        float sum;
+
+        sum = 0.0f;
+        for (i = 0; i < in_chan; ++i) {
+            sum += gain[o][i];
+        }
+        for (i = 0; i < in_chan; ++i) {
+            if (sum > 1.0f) {           // scale down, can't clip
+                gain[o][i] /= sum;
+            }
+            AudioMixMatrix[in_chan][out_chan][o][i] = lrintf(gain[o][i] * 32767.0f);
+            AudioMixGain[in_chan][out_chan][i][o] = gain[o][i];
+        }
+    }
+}
+
+/**
+**	Mix @a in_chan channels to @a out_chan, generic C version.
 **
 **	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
 **	@param frames	number of frames in sample buffer
 **	@param out	output sample buffer
+**	@param out_chan	nr. of output channels
+**	@param matrix	Q15 mix matrix [out channel][in channel]
 */
-static void AudioMono2Stereo(const int16_t * in, int frames, int16_t * out)
+static void AudioMixC(const int16_t * in, int in_chan, int frames, int16_t * out, int out_chan,
+    const int16_t(*matrix)[8])
 {
-    int i;
+    while (frames--) {
+        int o;
 
-    for (i = 0; i < frames; ++i) {
-        int t;
+        for (o = 0; o < out_chan; ++o) {
+            int32_t t;
+            int i;
 
-        t = in[i];
-        out[i * 2 + 0] = t;
-        out[i * 2 + 1] = t;
+            t = 1 << 14;                // round
+            for (i = 0; i < in_chan; ++i) {
+                t += in[i] * matrix[o][i];
+            }
+            t >>= 15;
+            if (t < INT16_MIN) {
+                t = INT16_MIN;
+            } else if (t > INT16_MAX) {
+                t = INT16_MAX;
+            }
+            out[o] = t;
+        }
+        in += in_chan;
+        out += out_chan;
     }
 }
 
+#ifdef USE_AUDIO_MIXER_X86
+
 /**
-**	Downmix stereo to mono.
+**	Mix @a in_chan channels to @a out_chan, SSE2 version.
+**
+**	A frame is loaded as 8 samples, the unused matrix columns are
+**	zero.  The last frames, which can't be loaded as 8 samples, are
+**	mixed in C.
 **
 **	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
 **	@param frames	number of frames in sample buffer
 **	@param out	output sample buffer
+**	@param out_chan	nr. of output channels
+**	@param matrix	Q15 mix matrix [out channel][in channel]
 */
-static void AudioStereo2Mono(const int16_t * in, int frames, int16_t * out)
+static __attribute__ ((target("sse2")))
+void AudioMixSse2(const int16_t * in, int in_chan, int frames, int16_t * out, int out_chan,
+    const int16_t(*matrix)[8])
 {
-    int i;
+    __m128i row[8];
+    __m128i round;
+    int safe;
+    int o;
+
+    for (o = 0; o < 8; ++o) {
+        row[o] = _mm_load_si128((const __m128i *)matrix[o]);
+    }
+    round = _mm_set1_epi32(1 << 14);
+    // frames which can be loaded and stored with 8 samples
+    safe = frames - (8 + in_chan - 1) / in_chan;
+    if (safe > frames - (8 + out_chan - 1) / out_chan) {
+        safe = frames - (8 + out_chan - 1) / out_chan;
+    }
+    frames -= safe > 0 ? safe : 0;
+
+    for (; safe > 0; --safe) {
+        __m128i x;
+        __m128i m0;
+        __m128i m1;
+        __m128i m2;
+        __m128i m3;
+        __m128i lo;
+        __m128i hi;
+
+        x = _mm_loadu_si128((const __m128i *)in);
+        // dot products of four rows, horizontal add by transposing
+        m0 = _mm_madd_epi16(x, row[0]);
+        m1 = _mm_madd_epi16(x, row[1]);
+        m2 = _mm_madd_epi16(x, row[2]);
+        m3 = _mm_madd_epi16(x, row[3]);
+        m0 = _mm_add_epi32(_mm_unpacklo_epi32(m0, m1), _mm_unpackhi_epi32(m0, m1));
+        m2 = _mm_add_epi32(_mm_unpacklo_epi32(m2, m3), _mm_unpackhi_epi32(m2, m3));
+        lo = _mm_add_epi32(_mm_unpacklo_epi64(m0, m2), _mm_unpackhi_epi64(m0, m2));
+        lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 15);
+        hi = lo;
+        if (out_chan > 4) {
+            m0 = _mm_madd_epi16(x, row[4]);
+            m1 = _mm_madd_epi16(x, row[5]);
+            m2 = _mm_madd_epi16(x, row[6]);
+            m3 = _mm_madd_epi16(x, row[7]);
+            m0 = _mm_add_epi32(_mm_unpacklo_epi32(m0, m1), _mm_unpackhi_epi32(m0, m1));
+            m2 = _mm_add_epi32(_mm_unpacklo_epi32(m2, m3), _mm_unpackhi_epi32(m2, m3));
+            hi = _mm_add_epi32(_mm_unpacklo_epi64(m0, m2), _mm_unpackhi_epi64(m0, m2));
+            hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 15);
+        }
+        // saturate, extra channels are overwritten by the next frame
+        _mm_storeu_si128((__m128i *) out, _mm_packs_epi32(lo, hi));
 
-    for (i = 0; i < frames; i += 2) {
-        out[i / 2] = (in[i + 0] + in[i + 1]) / 2;
+        in += in_chan;
+        out += out_chan;
     }
+    AudioMixC(in, in_chan, frames, out, out_chan, matrix);
 }
 
+#endif
+
+#ifdef USE_AUDIO_MIXER_NEON
+
 /**
-**	Downmix surround to stereo.
-**
-**	ffmpeg L  R  C	Ls Rs		-> alsa L R  Ls Rs C
-**	ffmpeg L  R  C	LFE Ls Rs	-> alsa L R  Ls Rs C  LFE
-**	ffmpeg L  R  C	LFE Ls Rs Rl Rr	-> alsa L R  Ls Rs C  LFE Rl Rr
+**	Mix @a in_chan channels to @a out_chan, NEON version.
 **
 **	@param in	input sample buffer
 **	@param in_chan	nr. of input channels
 **	@param frames	number of frames in sample buffer
 **	@param out	output sample buffer
+**	@param out_chan	nr. of output channels
+**	@param matrix	Q15 mix matrix [out channel][in channel]
+*/
+static void AudioMixNeon(const int16_t * in, int in_chan, int frames, int16_t * out, int out_chan,
+    const int16_t(*matrix)[8])
+{
+    int16x8_t row[8];
+    int safe;
+    int o;
+
+    for (o = 0; o < 8; ++o) {
+        row[o] = vld1q_s16(matrix[o]);
+    }
+    // frames which can be loaded with 8 samples
+    safe = frames - (8 + in_chan - 1) / in_chan;
+    frames -= safe > 0 ? safe : 0;
+
+    for (; safe > 0; --safe) {
+        int16x8_t x;
+
+        x = vld1q_s16(in);
+        for (o = 0; o < out_chan; ++o) {
+            int32x4_t t;
+
+            t = vmull_s16(vget_low_s16(x), vget_low_s16(row[o]));
+            t = vmlal_s16(t, vget_high_s16(x), vget_high_s16(row[o]));
+            out[o] = vqmovns_s32((vaddvq_s32(t) + (1 << 14)) >> 15);
+        }
+        in += in_chan;
+        out += out_chan;
+    }
+    AudioMixC(in, in_chan, frames, out, out_chan, matrix);
+}
+
+#endif
+
+/**
+**	Mix float @a in_chan channels to @a out_chan, generic C version.
+**
+**	Gain, mix, clipping and conversion to the hardware format are
+**	done in one pass.
+**
+**	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
+**	@param frames	number of frames in sample buffer
+**	@param out	output sample buffer in hardware format
+**	@param out_chan	nr. of output channels
+**	@param matrix	mix gains [in channel][out channel]
+**	@param format	hardware sample format
 */
-static void AudioSurround2Stereo(const int16_t * in, int in_chan, int frames, int16_t * out)
+static void AudioMixFloatC(const float *in, int in_chan, int frames, void *out, int out_chan,
+    const float (*matrix)[8], int format)
 {
+    int16_t *out16;
+    int32_t *out32;
+    float *outf;
+
+    out16 = out;
+    out32 = out;
+    outf = out;
     while (frames--) {
-        int l;
-        int r;
-
-        switch (in_chan) {
-            case 3:                    // stereo or surround? =>stereo
-                l = in[0] * 600;        // L
-                r = in[1] * 600;        // R
-                l += in[2] * 400;       // C
-                r += in[2] * 400;
-                break;
-            case 4:                    // quad or surround? =>quad
-                l = in[0] * 600;        // L
-                r = in[1] * 600;        // R
-                l += in[2] * 400;       // Ls
-                r += in[3] * 400;       // Rs
-                break;
-            case 5:                    // 5.0
-                l = in[0] * 500;        // L
-                r = in[1] * 500;        // R
-                l += in[2] * 200;       // Ls
-                r += in[3] * 200;       // Rs
-                l += in[4] * 300;       // C
-                r += in[4] * 300;
-                break;
-            case 6:                    // 5.1
-                l = in[0] * 400;        // L
-                r = in[1] * 400;        // R
-                l += in[2] * 200;       // Ls
-                r += in[3] * 200;       // Rs
-                l += in[4] * 300;       // C
-                r += in[4] * 300;
-                l += in[5] * 100;       // LFE
-                r += in[5] * 100;
-                break;
-            case 7:                    // 7.0
-                l = in[0] * 400;        // L
-                r = in[1] * 400;        // R
-                l += in[2] * 200;       // Ls
-                r += in[3] * 200;       // Rs
-                l += in[4] * 300;       // C
-                r += in[4] * 300;
-                l += in[5] * 100;       // RL
-                r += in[6] * 100;       // RR
+        int o;
+
+        for (o = 0; o < out_chan; ++o) {
+            float t;
+            int i;
+
+            t = 0.0f;
+            for (i = 0; i < in_chan; ++i) {
+                t += in[i] * matrix[i][o];
+            }
+            if (t < -1.0f) {
+                t = -1.0f;
+            } else if (t > 1.0f) {
+                t = 1.0f;
+            }
+            switch (format) {
+                case AudioFormatS16:
+                    *out16++ = lrintf(t * 32767.0f);
+                    break;
+                case AudioFormatS32:
+                    // largest float below 2^31
+                    *out32++ = lrintf(t * 2147483520.0f);
+                    break;
+                default:
+                    *outf++ = t;
+                    break;
+            }
+        }
+        in += in_chan;
+    }
+}
+
+#ifdef USE_AUDIO_MIXER_X86
+
+/**
+**	Mix float @a in_chan channels to @a out_chan, SSE2 version.
+**
+**	A frame is mixed and stored as 8 samples, the unused matrix
+**	columns are zero.  The last frames, which can't be stored as 8
+**	samples, are mixed in C.
+**
+**	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
+**	@param frames	number of frames in sample buffer
+**	@param out	output sample buffer in hardware format
+**	@param out_chan	nr. of output channels
+**	@param matrix	mix gains [in channel][out channel]
+**	@param format	hardware sample format
+*/
+static __attribute__ ((target("sse2")))
+void AudioMixFloatSse2(const float *in, int in_chan, int frames, void *out, int out_chan,
+    const float (*matrix)[8], int format)
+{
+    __m128 one;
+    __m128 minus_one;
+    __m128 scale;
+    uint8_t *p;
+    int size;
+    int safe;
+
+    one = _mm_set1_ps(1.0f);
+    minus_one = _mm_set1_ps(-1.0f);
+    scale = _mm_set1_ps(format == AudioFormatS16 ? 32767.0f : 2147483520.0f);
+    size = format == AudioFormatS16 ? 2 : 4;
+    // frames which can be stored with 8 samples
+    safe = frames - (8 + out_chan - 1) / out_chan;
+    if (safe < 0) {
+        safe = 0;
+    }
+    frames -= safe;
+
+    p = out;
+    for (; safe > 0; --safe) {
+        __m128 lo;
+        __m128 hi;
+        int i;
+
+        lo = _mm_setzero_ps();
+        hi = _mm_setzero_ps();
+        for (i = 0; i < in_chan; ++i) {
+            __m128 x;
+
+            x = _mm_set1_ps(in[i]);
+            lo = _mm_add_ps(lo, _mm_mul_ps(x, _mm_load_ps(matrix[i])));
+            hi = _mm_add_ps(hi, _mm_mul_ps(x, _mm_load_ps(matrix[i] + 4)));
+        }
+        lo = _mm_max_ps(_mm_min_ps(lo, one), minus_one);
+        hi = _mm_max_ps(_mm_min_ps(hi, one), minus_one);
+        // extra channels are overwritten by the next frame
+        switch (format) {
+            case AudioFormatS16:
+                _mm_storeu_si128((__m128i *) p, _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(lo, scale)),
+                        _mm_cvtps_epi32(_mm_mul_ps(hi, scale))));
                 break;
-            case 8:                    // 7.1
-                l = in[0] * 400;        // L
-                r = in[1] * 400;        // R
-                l += in[2] * 150;       // Ls
-                r += in[3] * 150;       // Rs
-                l += in[4] * 250;       // C
-                r += in[4] * 250;
-                l += in[5] * 100;       // LFE
-                r += in[5] * 100;
-                l += in[6] * 100;       // RL
-                r += in[7] * 100;       // RR
+            case AudioFormatS32:
+                _mm_storeu_si128((__m128i *) p, _mm_cvtps_epi32(_mm_mul_ps(lo, scale)));
+                _mm_storeu_si128((__m128i *) p + 1, _mm_cvtps_epi32(_mm_mul_ps(hi, scale)));
                 break;
             default:
-                abort();
+                _mm_storeu_ps((float *)p, lo);
+                _mm_storeu_ps((float *)p + 4, hi);
+                break;
         }
         in += in_chan;
-
-        out[0] = l / 1000;
-        out[1] = r / 1000;
-        out += 2;
+        p += out_chan * size;
     }
+    AudioMixFloatC(in, in_chan, frames, p, out_chan, matrix, format);
 }
 
+#endif
+
+#ifdef USE_AUDIO_MIXER_NEON
+
 /**
-**	Upmix @a in_chan channels to @a out_chan.
+**	Mix float @a in_chan channels to @a out_chan, NEON version.
 **
 **	@param in	input sample buffer
 **	@param in_chan	nr. of input channels
 **	@param frames	number of frames in sample buffer
-**	@param out	output sample buffer
+**	@param out	output sample buffer in hardware format
 **	@param out_chan	nr. of output channels
+**	@param matrix	mix gains [in channel][out channel]
+**	@param format	hardware sample format
 */
-static void AudioUpmix(const int16_t * in, int in_chan, int frames, int16_t * out, int out_chan)
+static void AudioMixFloatNeon(const float *in, int in_chan, int frames, void *out, int out_chan,
+    const float (*matrix)[8], int format)
 {
-    while (frames--) {
+    float32x4_t one;
+    float32x4_t minus_one;
+    float32x4_t scale;
+    uint8_t *p;
+    int size;
+    int safe;
+
+    one = vdupq_n_f32(1.0f);
+    minus_one = vdupq_n_f32(-1.0f);
+    scale = vdupq_n_f32(format == AudioFormatS16 ? 32767.0f : 2147483520.0f);
+    size = format == AudioFormatS16 ? 2 : 4;
+    // frames which can be stored with 8 samples
+    safe = frames - (8 + out_chan - 1) / out_chan;
+    if (safe < 0) {
+        safe = 0;
+    }
+    frames -= safe;
+
+    p = out;
+    for (; safe > 0; --safe) {
+        float32x4_t lo;
+        float32x4_t hi;
         int i;
 
-        for (i = 0; i < in_chan; ++i) { // copy existing channels
-            *out++ = *in++;
+        lo = vdupq_n_f32(0.0f);
+        hi = vdupq_n_f32(0.0f);
+        for (i = 0; i < in_chan; ++i) {
+            lo = vmlaq_n_f32(lo, vld1q_f32(matrix[i]), in[i]);
+            hi = vmlaq_n_f32(hi, vld1q_f32(matrix[i] + 4), in[i]);
         }
-        for (; i < out_chan; ++i) {     // silents missing channels
-            *out++ = 0;
+        lo = vmaxq_f32(vminq_f32(lo, one), minus_one);
+        hi = vmaxq_f32(vminq_f32(hi, one), minus_one);
+        switch (format) {
+            case AudioFormatS16:
+                vst1q_s16((int16_t *) p, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(lo, scale))),
+                        vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(hi, scale)))));
+                break;
+            case AudioFormatS32:
+                vst1q_s32((int32_t *) p, vcvtnq_s32_f32(vmulq_f32(lo, scale)));
+                vst1q_s32((int32_t *) p + 4, vcvtnq_s32_f32(vmulq_f32(hi, scale)));
+                break;
+            default:
+                vst1q_f32((float *)p, lo);
+                vst1q_f32((float *)p + 4, hi);
+                break;
         }
+        in += in_chan;
+        p += out_chan * size;
     }
+    AudioMixFloatC(in, in_chan, frames, p, out_chan, matrix, format);
+}
+
+#endif
+
+/**
+**	Build mix matrices for all channel combinations, select kernels.
+*/
+static void AudioMixerInit(void)
+{
+    int in_chan;
+    int out_chan;
+
+    for (in_chan = 1; in_chan <= 8; ++in_chan) {
+        for (out_chan = 1; out_chan <= 8; ++out_chan) {
+            AudioMixMatrixBuild(in_chan, out_chan);
+        }
+    }
+    AudioMixKernel = AudioMixC;
+    AudioMixFloatKernel = AudioMixFloatC;
+#ifdef USE_AUDIO_MIXER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        AudioMixKernel = AudioMixSse2;
+        AudioMixFloatKernel = AudioMixFloatSse2;
+    }
+#endif
+#ifdef USE_AUDIO_MIXER_NEON
+    AudioMixKernel = AudioMixNeon;
+    AudioMixFloatKernel = AudioMixFloatNeon;
+#endif
+    Debug(3, "audio: mixer kernel %s\n", AudioMixKernel == AudioMixC ? "C" : "SIMD");
 }
 
 /**
 **	Resample ffmpeg sample format to hardware format.
 **
-**	FIXME: use libswresample for this and move it to codec.
-**	FIXME: ffmpeg to alsa conversion is already done in codec.c.
-**
-**	ffmpeg L  R  C	Ls Rs		-> alsa L R  Ls Rs C
-**	ffmpeg L  R  C	LFE Ls Rs	-> alsa L R  Ls Rs C  LFE
-**	ffmpeg L  R  C	LFE Ls Rs Rl Rr	-> alsa L R  Ls Rs C  LFE Rl Rr
+**	Every 1 - 8 channel combination is mixed with its precomputed
+**	matrix, the samples are in alsa channel order.
 **
 **	@param in	input sample buffer
 **	@param in_chan	nr. of input channels
@@ -569,44 +1156,11 @@ static void AudioUpmix(const int16_t * in, int in_chan, int frames, int16_t * ou
 */
 static void AudioResample(const int16_t * in, int in_chan, int frames, int16_t * out, int out_chan)
 {
-    switch (in_chan * 8 + out_chan) {
-        case 1 * 8 + 1:
-        case 2 * 8 + 2:
-        case 3 * 8 + 3:
-        case 4 * 8 + 4:
-        case 5 * 8 + 5:
-        case 6 * 8 + 6:
-        case 7 * 8 + 7:
-        case 8 * 8 + 8:                // input = output channels
-            memcpy(out, in, frames * in_chan * AudioBytesProSample);
-            break;
-        case 2 * 8 + 1:
-            AudioStereo2Mono(in, frames, out);
-            break;
-        case 1 * 8 + 2:
-            AudioMono2Stereo(in, frames, out);
-            break;
-        case 3 * 8 + 2:
-        case 4 * 8 + 2:
-        case 5 * 8 + 2:
-        case 6 * 8 + 2:
-        case 7 * 8 + 2:
-        case 8 * 8 + 2:
-            AudioSurround2Stereo(in, in_chan, frames, out);
-            break;
-        case 5 * 8 + 6:
-        case 3 * 8 + 8:
-        case 5 * 8 + 8:
-        case 6 * 8 + 8:
-            AudioUpmix(in, in_chan, frames, out, out_chan);
-            break;
-
-        default:
-            Error("audio: unsupported %d -> %d channels resample\n", in_chan, out_chan);
-            // play silence
-            memset(out, 0, frames * out_chan * AudioBytesProSample);
-            break;
+    if (in_chan == out_chan) {          // input = output channels
+        memcpy(out, in, frames * in_chan * AudioBytesProSample);
+        return;
     }
+    AudioMixKernel(in, in_chan, frames, out, out_chan, AudioMixMatrix[in_chan][out_chan]);
 }
 
 #endif
@@ -624,6 +1178,9 @@ typedef struct _audio_ring_ring_
 {
     char FlushBuffers;                  ///< flag: flush buffers
     char Passthrough;                   ///< flag: use pass-through (AC-3, ...)
+    char Float;                         ///< flag: use float pipeline
+    char HwFormat;                      ///< hardware sample format
+    char HwBytesProSample;              ///< hardware bytes per sample
     int16_t PacketSize;                 ///< packet size
     unsigned HwSampleRate;              ///< hardware sample rate in Hz
     unsigned HwChannels;                ///< hardware number of channels
@@ -683,6 +1240,14 @@ static int AudioRingAdd(unsigned sample_rate, int channels, int passthrough)
 
     AudioRing[AudioRingWrite].FlushBuffers = 0;
     AudioRing[AudioRingWrite].Passthrough = passthrough;
+#ifdef USE_AUDIO_MIXER
+    AudioRing[AudioRingWrite].Float = AudioFloat && !passthrough;
+#else
+    AudioRing[AudioRingWrite].Float = 0;
+#endif
+    AudioRing[AudioRingWrite].HwFormat = AudioRing[AudioRingWrite].Float ? AudioHwFormat : AudioFormatS16;
+    AudioRing[AudioRingWrite].HwBytesProSample =
+        AudioRing[AudioRingWrite].HwFormat == AudioFormatS16 ? AudioBytesProSample : 4;
     AudioRing[AudioRingWrite].PacketSize = 0;
     AudioRing[AudioRingWrite].InSampleRate = sample_rate;
     AudioRing[AudioRingWrite].InChannels = channels;
@@ -715,7 +1280,7 @@ static void AudioRingInit(void)
     int i;
 
     for (i = 0; i < AUDIO_RING_MAX; ++i) {
-        // ~2s 8ch 16bit
+        // ~2s 8ch 32bit
         AudioRing[i].RingBuffer = RingBufferNew(AudioRingBufferSize);
     }
     atomic_set(&AudioRingFilled, 0);
@@ -724,20 +1289,249 @@ static void AudioRingInit(void)
 /**
 **	Cleanup audio ring.
 */
-static void AudioRingExit(void)
+static void AudioRingExit(void)
+{
+    int i;
+
+    for (i = 0; i < AUDIO_RING_MAX; ++i) {
+        if (AudioRing[i].RingBuffer) {
+            RingBufferDel(AudioRing[i].RingBuffer);
+            AudioRing[i].RingBuffer = NULL;
+        }
+        AudioRing[i].HwSampleRate = 0;  // checked for valid setup
+        AudioRing[i].InSampleRate = 0;
+    }
+    AudioRingRead = 0;
+    AudioRingWrite = 0;
+}
+
+//----------------------------------------------------------------------------
+//  thread wakeup
+//----------------------------------------------------------------------------
+
+static int AudioEventFd = -1;           ///< eventfd to wakeup play thread
+static volatile char AudioStarved;      ///< play thread waits for samples
+static int AudioWakeups;                ///< statistic play thread wakeups
+static uint64_t AudioWakeupTime;        ///< time of pending wakeup in us
+static int AudioWakeupLatency;          ///< max. wakeup to handling in us
+
+/**
+**	Get monotonic time in us.
+*/
+static uint64_t AudioGetUs(void)
+{
+    struct timespec tspec;
+
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t) tspec.tv_sec * 1000 * 1000 + tspec.tv_nsec / 1000;
+}
+
+/**
+**	Wakeup the play thread.
+**
+**	Commands (enqueue, flush, pause, ...) are handled at once, without
+**	waiting for a poll timeout of the play thread.
+*/
+static void AudioWakeup(void)
+{
+    uint64_t one;
+
+    if (AudioEventFd < 0) {
+        return;
+    }
+    if (!AudioWakeupTime) {             // only statistic, races are harmless
+        AudioWakeupTime = AudioGetUs();
+    }
+    one = 1;
+    if (write(AudioEventFd, &one, sizeof(one)) != sizeof(one)) {
+        Debug(3, "audio: can't wakeup play thread\n");
+    }
+}
+
+/**
+**	Consume pending wakeups of the play thread.
+**
+**	@param account	true account wakeup in statistic
+*/
+static void AudioWakeupDone(int account)
+{
+    uint64_t value;
+
+    if (AudioEventFd < 0 || read(AudioEventFd, &value, sizeof(value)) != sizeof(value)) {
+        return;
+    }
+    if (account) {
+        AudioWakeups++;
+        if (AudioWakeupTime) {
+            int latency;
+
+            latency = AudioGetUs() - AudioWakeupTime;
+            if (latency > AudioWakeupLatency) {
+                AudioWakeupLatency = latency;
+            }
+        }
+    }
+    AudioWakeupTime = 0;
+}
+
+/**
+**	Wait for poll descriptors or wakeup of the play thread.
+**
+**	@param fds	poll descriptors, one extra entry is used for wakeup
+**	@param n	number of poll descriptors
+**	@param timeout	timeout in ms
+**
+**	@retval <0	error
+**	@retval 0	timeout or wakeup
+**	@retval >0	poll descriptors ready
+*/
+static int AudioPoll(struct pollfd *fds, int n, int timeout)
+{
+    int err;
+
+    fds[n].fd = AudioEventFd;           // poll ignores -1
+    fds[n].events = POLLIN;
+    fds[n].revents = 0;
+    err = poll(fds, n + 1, timeout);
+    if (err < 0) {
+        return errno == EINTR ? 0 : err;
+    }
+    if (fds[n].revents & POLLIN) {
+        AudioWakeupDone(1);
+        --err;
+    }
+    return err;
+}
+
+//----------------------------------------------------------------------------
+//  audio clock
+//----------------------------------------------------------------------------
+
+/**
+**	Audio clock recovery.
+**
+**	The output modules deliver paired samples of the hardware delay and
+**	the monotonic time, when the delay was valid.  A second order delay
+**	locked loop filters them into the audio position and the audio clock
+**	rate, video sync and drift correction read the filtered clock.
+**
+**	Written by the play thread, read by the video and decoder threads
+**	with a sequence lock.
+*/
+typedef struct _audio_clock_
+{
+    volatile unsigned Seq;              ///< sequence lock, odd while written
+    char Valid;                         ///< clock is locked
+    char Outliers;                      ///< consecutive outliers
+    uint64_t Locked;                    ///< time of lock in us
+    uint64_t Time;                      ///< time of position in us
+    double PTS;                         ///< audio position in time stamps
+    double Rate;                        ///< time stamps per us
+} AudioClockDll;
+
+static AudioClockDll AudioClock;        ///< filtered audio clock
+
+static const double AudioClockBandwidth = 0.03;    ///< loop bandwidth in Hz
+static const int AudioClockGate = 50 * 90;  ///< outlier gate in time stamps
+static const int AudioClockStale = 500; ///< max. time between samples in ms
+static const int AudioClockMaxDrift = 1000; ///< max. clock drift in ppm
+
+/**
+**	Reset audio clock, new stream or discontinuity.
+*/
+static void AudioClockReset(void)
+{
+    AudioClock.Seq++;
+    __sync_synchronize();
+    AudioClock.Valid = 0;
+    __sync_synchronize();
+    AudioClock.Seq++;
+}
+
+/**
+**	Update audio clock with a paired delay, time sample.
+**
+**	@param delay	hardware delay in time stamps
+**	@param time	monotonic time in us, when delay was valid
+*/
+static void AudioClockUpdate(int64_t delay, uint64_t time)
+{
+    const AudioRingRing *ring;
+    double pts;
+    double err;
+    double dt;
+
+    ring = &AudioRing[AudioRingRead];
+    // no valid time stamp or multiple buffers, invalid position
+    if (ring->PTS == (int64_t) INT64_C(0x8000000000000000) || !ring->HwSampleRate
+        || atomic_read(&AudioRingFilled)) {
+        if (AudioClock.Valid) {
+            AudioClockReset();
+        }
+        return;
+    }
+    // position of the samples leaving the speaker
+    pts = ring->PTS - delay - ((int64_t) RingBufferUsedBytes(ring->RingBuffer) * 90 * 1000)
+        / (ring->HwSampleRate * ring->HwChannels * ring->HwBytesProSample);
+
+    AudioClock.Seq++;
+    __sync_synchronize();
+    dt = (double)time - AudioClock.Time;
+    err = 0.0;
+    if (AudioClock.Valid && dt > 0 && dt < AudioClockStale * 1000) {
+        err = pts - (AudioClock.PTS + AudioClock.Rate * dt);
+        if (fabs(err) > AudioClockGate && ++AudioClock.Outliers < 3) {
+            goto out;                   // ignore single outliers
+        }
+    }
+    if (!AudioClock.Valid || dt <= 0 || dt >= AudioClockStale * 1000 || fabs(err) > AudioClockGate) {
+        Debug(4, "audio: clock reset %.0fms\n", err / 90);
+        AudioClock.Valid = 1;
+        AudioClock.Locked = time;
+        AudioClock.PTS = pts;
+        AudioClock.Rate = 90.0 / 1000.0;
+    } else {
+        double omega;
+        double rate;
+
+        omega = 2 * M_PI * AudioClockBandwidth * dt / (1000 * 1000);
+        AudioClock.PTS += AudioClock.Rate * dt + M_SQRT2 * omega * err;
+        rate = AudioClock.Rate + omega * omega * err / dt;
+        if (rate < 0.09 * (1.0 - AudioClockMaxDrift / 1e6)) {
+            rate = 0.09 * (1.0 - AudioClockMaxDrift / 1e6);
+        } else if (rate > 0.09 * (1.0 + AudioClockMaxDrift / 1e6)) {
+            rate = 0.09 * (1.0 + AudioClockMaxDrift / 1e6);
+        }
+        AudioClock.Rate = rate;
+    }
+    AudioClock.Outliers = 0;
+    AudioClock.Time = time;
+  out:
+    __sync_synchronize();
+    AudioClock.Seq++;
+}
+
+/**
+**	Read a consistent copy of the audio clock.
+**
+**	@param[out] clock	copy of the audio clock
+**
+**	@returns true, if the clock is locked and up to date.
+*/
+static int AudioClockRead(AudioClockDll * clock)
 {
-    int i;
+    unsigned seq;
 
-    for (i = 0; i < AUDIO_RING_MAX; ++i) {
-        if (AudioRing[i].RingBuffer) {
-            RingBufferDel(AudioRing[i].RingBuffer);
-            AudioRing[i].RingBuffer = NULL;
+    do {
+        while ((seq = AudioClock.Seq) & 1) {
+            sched_yield();
         }
-        AudioRing[i].HwSampleRate = 0;  // checked for valid setup
-        AudioRing[i].InSampleRate = 0;
-    }
-    AudioRingRead = 0;
-    AudioRingWrite = 0;
+        __sync_synchronize();
+        *clock = AudioClock;
+        __sync_synchronize();
+    } while (seq != AudioClock.Seq);
+
+    return clock->Valid && AudioGetUs() - clock->Time < (uint64_t) AudioClockStale * 1000;
 }
 
 #ifdef USE_ALSA
@@ -751,6 +1545,12 @@ static void AudioRingExit(void)
 //----------------------------------------------------------------------------
 
 static snd_pcm_t *AlsaPCMHandle;        ///< alsa pcm handle
+static const int AlsaPollTimeout = 100; ///< poll timeout in ms
+static char AlsaTstamp;                 ///< status time stamps are monotonic
+static snd_pcm_format_t AlsaSetupFormat = SND_PCM_FORMAT_UNKNOWN;   ///< format of pcm setup
+static int AlsaSetupRate;               ///< sample rate of pcm setup
+static int AlsaSetupChannels;           ///< channels of pcm setup
+static int AlsaSetupPassthrough;        ///< pass-through of pcm setup
 static char AlsaCanPause;               ///< hw supports pause
 static int AlsaUseMmap;                 ///< use mmap
 
@@ -773,6 +1573,7 @@ static int AlsaRatio;                   ///< internal -> mixer ratio * 1000
 */
 static int AlsaPlayRingbuffer(void)
 {
+    struct pollfd fds[1];
     int first;
 
     first = 1;
@@ -813,7 +1614,7 @@ static int AlsaPlayRingbuffer(void)
                             Error(_("audio/alsa: snd_pcm_start(): %s\n"), snd_strerror(err));
                         }
                     }
-                    usleep(5 * 1000);
+                    AudioPoll(fds, 0, 5);
                 }
             }
             Debug(4, "audio/alsa: break state '%s'\n", snd_pcm_state_name(snd_pcm_state(AlsaPCMHandle)));
@@ -836,12 +1637,6 @@ static int AlsaPlayRingbuffer(void)
         if (!avail) {                   // full or buffer empty
             break;
         }
-        // muting pass-through AC-3, can produce disturbance
-        if (AudioMute || (AudioSoftVolume && !AudioRing[AudioRingRead].Passthrough)) {
-            // FIXME: quick&dirty cast
-            AudioSoftAmplifier((int16_t *) p, avail);
-            // FIXME: if not all are written, we double amplify them
-        }
         frames = snd_pcm_bytes_to_frames(AlsaPCMHandle, avail);
 #ifdef DEBUG
         if (avail != snd_pcm_frames_to_bytes(AlsaPCMHandle, frames)) {
@@ -916,10 +1711,37 @@ static void AlsaFlushBuffers(void)
 //  thread playback
 //----------------------------------------------------------------------------
 
+/**
+**	Feed the audio clock with the pcm status.
+**
+**	The status pairs the delay with the time stamp of the hardware
+**	pointer update.
+*/
+static void AlsaUpdateClock(void)
+{
+    snd_pcm_status_t *status;
+    snd_htimestamp_t tstamp;
+    uint64_t time;
+
+    snd_pcm_status_alloca(&status);
+    if (snd_pcm_status(AlsaPCMHandle, status) < 0 || snd_pcm_status_get_state(status) != SND_PCM_STATE_RUNNING) {
+        return;
+    }
+    snd_pcm_status_get_htstamp(status, &tstamp);
+    if (AlsaTstamp && (tstamp.tv_sec || tstamp.tv_nsec)) {
+        time = (uint64_t) tstamp.tv_sec * 1000 * 1000 + tstamp.tv_nsec / 1000;
+    } else {
+        time = AudioGetUs();
+    }
+    AudioClockUpdate(((int64_t) snd_pcm_status_get_delay(status) * 90 * 1000)
+        / AudioRing[AudioRingRead].HwSampleRate, time);
+}
+
 /**
 **	Alsa thread
 **
-**	Play some samples and return.
+**	Wait on the pcm poll descriptors and the wakeup event, play some
+**	samples and return.
 **
 **	@retval	-1	error
 **	@retval 0	underrun
@@ -927,30 +1749,61 @@ static void AlsaFlushBuffers(void)
 */
 static int AlsaThread(void)
 {
+    struct pollfd fds[16];
     int err;
 
     if (!AlsaPCMHandle) {
-        usleep(24 * 1000);
+        AudioPoll(fds, 0, 24);
         return -1;
     }
     for (;;) {
+        unsigned short revents;
+        int n;
+
         if (AudioPaused) {
             return 1;
         }
         // wait for space in kernel buffers
-        if ((err = snd_pcm_wait(AlsaPCMHandle, 24)) < 0) {
+        n = snd_pcm_poll_descriptors(AlsaPCMHandle, fds, sizeof(fds) / sizeof(*fds) - 1);
+        if (n < 0 || (err = AudioPoll(fds, n, AlsaPollTimeout)) < 0) {
+            Error(_("audio/alsa: poll(): %s\n"), n < 0 ? snd_strerror(n) : strerror(errno));
+            AudioPoll(fds, 0, 24);
+            return -1;
+        }
+        if (!err) {                     // timeout or some commands
+            return 1;
+        }
+        if ((err = snd_pcm_poll_descriptors_revents(AlsaPCMHandle, fds, n, &revents)) < 0) {
+            Error(_("audio/alsa: snd_pcm_poll_descriptors_revents(): %s\n"), snd_strerror(err));
+            return -1;
+        }
+        if (revents & (POLLERR | POLLNVAL)) {
+            switch (snd_pcm_state(AlsaPCMHandle)) {
+                case SND_PCM_STATE_XRUN:
+                    err = -EPIPE;
+                    break;
+                case SND_PCM_STATE_SUSPENDED:
+                    err = -ESTRPIPE;
+                    break;
+                default:
+                    err = -EIO;
+                    break;
+            }
             Warning(_("audio/alsa: wait underrun error? '%s'\n"), snd_strerror(err));
             err = snd_pcm_recover(AlsaPCMHandle, err, 0);
             if (err >= 0) {
                 continue;
             }
-            Error(_("audio/alsa: snd_pcm_wait(): %s\n"), snd_strerror(err));
-            usleep(24 * 1000);
+            Error(_("audio/alsa: poll(): %s\n"), snd_strerror(err));
+            AudioPoll(fds, 0, 24);
             return -1;
         }
+        if (!(revents & POLLOUT)) {
+            return 1;
+        }
         break;
     }
-    if (!err || AudioPaused) {          // timeout or some commands
+    if (AudioPaused) {                  // some commands
         return 1;
     }
 
@@ -966,9 +1819,13 @@ static int AlsaThread(void)
             Debug(3, "audio/alsa: stopping play '%s'\n", snd_pcm_state_name(state));
             return 0;
         }
-
-        usleep(24 * 1000);              // let fill/empty the buffers
+        // let fill the buffers, enqueue wakes up
+        AudioStarved = 1;
+        AudioPoll(fds, 0, 24);
+        AudioStarved = 0;
+        return 1;
     }
+    AlsaUpdateClock();
     return 1;
 }
 
@@ -1168,6 +2025,39 @@ static int64_t AlsaGetDelay(void)
     return pts;
 }
 
+/**
+**	Set start threshold of the alsa pcm setup.
+**
+**	@param freq		sample frequency
+**	@param channels		number of channels
+**	@param sample_size	bytes per sample
+*/
+static void AlsaSetStartThreshold(int freq, int channels, int sample_size)
+{
+    snd_pcm_uframes_t buffer_size;
+    snd_pcm_uframes_t period_size;
+    int delay;
+
+    snd_pcm_get_params(AlsaPCMHandle, &buffer_size, &period_size);
+    AudioStartThreshold = snd_pcm_frames_to_bytes(AlsaPCMHandle, period_size);
+    // buffer time/delay in ms
+    delay = AudioBufferTime;
+    if (VideoAudioDelay > 0) {
+        delay += VideoAudioDelay / 90;
+    }
+    if (AudioStartThreshold < (freq * channels * sample_size * delay) / 1000U) {
+        AudioStartThreshold = (freq * channels * sample_size * delay) / 1000U;
+    }
+    // no bigger, than 1/3 the buffer
+    if (AudioStartThreshold > AudioRingBufferSize / 3) {
+        AudioStartThreshold = AudioRingBufferSize / 3;
+    }
+    if (!AudioDoingInit) {
+        Info(_("audio/alsa: start delay %ums\n"), (AudioStartThreshold * 1000)
+            / (freq * channels * sample_size));
+    }
+}
+
 /**
 **	Setup alsa audio for requested format.
 **
@@ -1185,13 +2075,46 @@ static int AlsaSetup(int *freq, int *channels, int passthrough)
 {
     snd_pcm_uframes_t buffer_size;
     snd_pcm_uframes_t period_size;
+    snd_pcm_format_t format;
+    int sample_size;
     int err;
-    int delay;
 
     if (!AlsaPCMHandle) {               // alsa not running yet
         // FIXME: if open fails for fe. pass-through, we never recover
         return -1;
     }
+    // sample format of the ring buffer, which is prepared
+    format = SND_PCM_FORMAT_S16;
+    if (!passthrough) {
+        switch (AudioRing[AudioRingRead].HwFormat) {
+            case AudioFormatS32:
+                format = SND_PCM_FORMAT_S32;
+                break;
+            case AudioFormatFloat:
+                format = SND_PCM_FORMAT_FLOAT;
+                break;
+        }
+    }
+    sample_size = snd_pcm_format_physical_width(format) / 8;
+
+    // unchanged format: keep the pcm open with its hw/sw params, restart it only
+    // only without the close+open fix, some HDMI devices need the reopen
+    if (AudioAlsaNoCloseOpen && format == AlsaSetupFormat && *freq == AlsaSetupRate && *channels == AlsaSetupChannels
+        && passthrough == AlsaSetupPassthrough) {
+        err = 0;
+        if (snd_pcm_state(AlsaPCMHandle) != SND_PCM_STATE_PREPARED) {
+            snd_pcm_drop(AlsaPCMHandle);
+            err = snd_pcm_prepare(AlsaPCMHandle);
+        }
+        if (err >= 0) {
+            Debug(3, "audio/alsa: keep pcm setup\n");
+            AlsaSetStartThreshold(*freq, *channels, sample_size);
+            return 0;
+        }
+        Warning(_("audio/alsa: can't restart pcm: %s\n"), snd_strerror(err));
+    }
+    AlsaSetupFormat = SND_PCM_FORMAT_UNKNOWN;   // invalid until setup is done
+
     if (!AudioAlsaNoCloseOpen) {        // close+open to fix HDMI no sound bug
         snd_pcm_t *handle;
 
@@ -1213,13 +2136,13 @@ static int AlsaSetup(int *freq, int *channels, int passthrough)
 
     for (;;) {
         if ((err =
-                snd_pcm_set_params(AlsaPCMHandle, SND_PCM_FORMAT_S16,
+                snd_pcm_set_params(AlsaPCMHandle, format,
                     AlsaUseMmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED, *channels, *freq, 1,
                     96 * 1000))) {
             // try reduced buffer size (needed for sunxi)
             // FIXME: alternativ make this configurable
             if ((err =
-                    snd_pcm_set_params(AlsaPCMHandle, SND_PCM_FORMAT_S16,
+                    snd_pcm_set_params(AlsaPCMHandle, format,
                         AlsaUseMmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED, *channels,
                         *freq, 1, 72 * 1000))) {
 
@@ -1241,6 +2164,17 @@ static int AlsaSetup(int *freq, int *channels, int passthrough)
         break;
     }
 
+    // monotonic time stamps paired with the delay in the pcm status
+    if (1) {
+        snd_pcm_sw_params_t *sw_params;
+
+        snd_pcm_sw_params_alloca(&sw_params);
+        AlsaTstamp = !snd_pcm_sw_params_current(AlsaPCMHandle, sw_params)
+            && !snd_pcm_sw_params_set_tstamp_mode(AlsaPCMHandle, sw_params, SND_PCM_TSTAMP_ENABLE)
+            && !snd_pcm_sw_params_set_tstamp_type(AlsaPCMHandle, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC)
+            && !snd_pcm_sw_params(AlsaPCMHandle, sw_params);
+        Debug(3, "audio/alsa: time stamps %s\n", AlsaTstamp ? "monotonic" : "none");
+    }
     // this is disabled, no advantages!
     if (0) {                            // no underruns allowed, play silence
         snd_pcm_sw_params_t *sw_params;
@@ -1269,28 +2203,17 @@ static int AlsaSetup(int *freq, int *channels, int passthrough)
 
     snd_pcm_get_params(AlsaPCMHandle, &buffer_size, &period_size);
     Debug(3, "audio/alsa: buffer size %lu %zdms, period size %lu %zdms\n", buffer_size,
-        snd_pcm_frames_to_bytes(AlsaPCMHandle, buffer_size) * 1000 / (*freq * *channels * AudioBytesProSample),
+        snd_pcm_frames_to_bytes(AlsaPCMHandle, buffer_size) * 1000 / (*freq * *channels * sample_size),
         period_size, snd_pcm_frames_to_bytes(AlsaPCMHandle,
-            period_size) * 1000 / (*freq * *channels * AudioBytesProSample));
+            period_size) * 1000 / (*freq * *channels * sample_size));
     Debug(3, "audio/alsa: state %s\n", snd_pcm_state_name(snd_pcm_state(AlsaPCMHandle)));
 
-    AudioStartThreshold = snd_pcm_frames_to_bytes(AlsaPCMHandle, period_size);
-    // buffer time/delay in ms
-    delay = AudioBufferTime;
-    if (VideoAudioDelay > 0) {
-        delay += VideoAudioDelay / 90;
-    }
-    if (AudioStartThreshold < (*freq * *channels * AudioBytesProSample * delay) / 1000U) {
-        AudioStartThreshold = (*freq * *channels * AudioBytesProSample * delay) / 1000U;
-    }
-    // no bigger, than 1/3 the buffer
-    if (AudioStartThreshold > AudioRingBufferSize / 3) {
-        AudioStartThreshold = AudioRingBufferSize / 3;
-    }
-    if (!AudioDoingInit) {
-        Info(_("audio/alsa: start delay %ums\n"), (AudioStartThreshold * 1000)
-            / (*freq * *channels * AudioBytesProSample));
-    }
+    AlsaSetStartThreshold(*freq, *channels, sample_size);
+
+    AlsaSetupFormat = format;
+    AlsaSetupRate = *freq;
+    AlsaSetupChannels = *channels;
+    AlsaSetupPassthrough = passthrough;
 
     return 0;
 }
@@ -1373,6 +2296,7 @@ static void AlsaExit(void)
         snd_pcm_close(AlsaPCMHandle);
         AlsaPCMHandle = NULL;
     }
+    AlsaSetupFormat = SND_PCM_FORMAT_UNKNOWN;
     if (AlsaMixer) {
         snd_mixer_close(AlsaMixer);
         AlsaMixer = NULL;
@@ -1455,12 +2379,6 @@ static int OssPlayRingbuffer(void)
         if (bi.bytes <= 0) {            // full or buffer empty
             break;                      // bi.bytes could become negative!
         }
-
-        if (AudioSoftVolume && !AudioRing[AudioRingRead].Passthrough) {
-            // FIXME: quick&dirty cast
-            AudioSoftAmplifier((int16_t *) p, bi.bytes);
-            // FIXME: if not all are written, we double amplify them
-        }
         for (;;) {
             n = write(OssPcmFildes, p, bi.bytes);
             if (n != bi.bytes) {
@@ -1511,29 +2429,27 @@ static void OssFlushBuffers(void)
 */
 static int OssThread(void)
 {
+    struct pollfd fds[2];
     int err;
 
     if (!OssPcmFildes) {
-        usleep(OssFragmentTime * 1000);
+        AudioPoll(fds, 0, OssFragmentTime);
         return -1;
     }
     for (;;) {
-        struct pollfd fds[1];
-
         if (AudioPaused) {
             return 1;
         }
-        // wait for space in kernel buffers
+        // wait for space in kernel buffers or wakeup
         fds[0].fd = OssPcmFildes;
         fds[0].events = POLLOUT | POLLERR;
-        // wait for space in kernel buffers
-        err = poll(fds, 1, OssFragmentTime);
+        err = AudioPoll(fds, 1, OssFragmentTime);
         if (err < 0) {
             if (err == EAGAIN) {
                 continue;
             }
             Error(_("audio/oss: error poll %s\n"), strerror(errno));
-            usleep(OssFragmentTime * 1000);
+            AudioPoll(fds, 0, OssFragmentTime);
             return -1;
         }
         break;
@@ -1546,10 +2462,14 @@ static int OssThread(void)
         if (err < 0) {                  // underrun error
             return -1;
         }
-        sched_yield();
-        usleep(OssFragmentTime * 1000); // let fill/empty the buffers
+        // let fill the buffers, enqueue wakes up
+        AudioStarved = 1;
+        AudioPoll(fds, 0, OssFragmentTime);
+        AudioStarved = 0;
         return 0;
     }
+    // oss has no time stamps, delay is valid now
+    AudioClockUpdate(AudioUsedModule->GetDelay(), AudioGetUs());
 
     return 1;
 }
@@ -1708,7 +2628,8 @@ static int64_t OssGetDelay(void)
     }
 
     pts = ((int64_t) delay * 90 * 1000)
-        / (AudioRing[AudioRingRead].HwSampleRate * AudioRing[AudioRingRead].HwChannels * AudioBytesProSample);
+        / (AudioRing[AudioRingRead].HwSampleRate * AudioRing[AudioRingRead].HwChannels *
+            AudioRing[AudioRingRead].HwBytesProSample);
 
     return pts;
 }
@@ -1735,6 +2656,9 @@ static int OssSetup(int *sample_rate, int *channels, int passthrough)
         // FIXME: if open fails for fe. pass-through, we never recover
         return -1;
     }
+    if (!passthrough && AudioRing[AudioRingRead].HwFormat != AudioFormatS16) {
+        return 1;                       // only 16 bit samples supported
+    }
 
     if (1) {                            // close+open for pcm / AC-3
         int fildes;
@@ -1985,7 +2909,8 @@ static int AudioNextRing(void)
 
     Debug(3, "audio: a/v next buf(%d,%4zdms)\n", atomic_read(&AudioRingFilled),
         (RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer) * 1000)
-        / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample));
+        / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+            AudioRing[AudioRingWrite].HwBytesProSample));
 
     // stop, if not enough in next buffer
     used = RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer);
@@ -2019,10 +2944,18 @@ static void *AudioPlayHandlerThread(void *dummy)
             // cond_wait can return, without signal!
         } while (!AudioRunning);
         pthread_mutex_unlock(&AudioMutex);
+        AudioWakeupDone(0);             // drop wakeups while stopped
+
+        if (AudioFlushTime) {           // start after zap
+            AudioStartLatency = GetMsTicks() - AudioFlushTime;
+            AudioFlushTime = 0;
+            Debug(3, "audio: start %dms after flush\n", AudioStartLatency);
+        }
 
         Debug(3, "audio: ----> %dms start\n", (AudioUsedBytes() * 1000)
             / (!AudioRing[AudioRingWrite].HwSampleRate + !AudioRing[AudioRingWrite].HwChannels +
-                AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample));
+                AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                    AudioRing[AudioRingWrite].HwBytesProSample));
 
         do {
             int filled;
@@ -2054,6 +2987,7 @@ static void *AudioPlayHandlerThread(void *dummy)
             if (flush) {
                 Debug(3, "audio: flush %d ring buffer(s)\n", flush);
                 AudioUsedModule->FlushBuffers();
+                AudioClockReset();
                 atomic_sub(flush, &AudioRingFilled);
                 if (AudioNextRing()) {
                     Debug(3, "audio: HandlerThread break after flush\n");
@@ -2088,6 +3022,7 @@ static void *AudioPlayHandlerThread(void *dummy)
 
                 atomic_dec(&AudioRingFilled);
                 AudioRingRead = (AudioRingRead + 1) % AUDIO_RING_MAX;
+                AudioClockReset();
 
                 passthrough = AudioRing[AudioRingRead].Passthrough;
                 sample_rate = AudioRing[AudioRingRead].HwSampleRate;
@@ -2111,84 +3046,357 @@ static void *AudioPlayHandlerThread(void *dummy)
                 Debug(3, "audio: HandlerThread break on paused");
                 break;
             }
-        } while (AudioRing[AudioRingRead].HwSampleRate);
+        } while (AudioRing[AudioRingRead].HwSampleRate);
+    }
+    return dummy;
+}
+
+/**
+**	Initialize audio thread.
+*/
+static void AudioInitThread(void)
+{
+    AudioThreadStop = 0;
+    if ((AudioEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        Error(_("audio: can't create wakeup eventfd: %s\n"), strerror(errno));
+    }
+    pthread_mutex_init(&AudioMutex, NULL);
+    pthread_cond_init(&AudioStartCond, NULL);
+    pthread_create(&AudioThread, NULL, AudioPlayHandlerThread, NULL);
+    pthread_setname_np(AudioThread, "softhddev audio");
+}
+
+/**
+**	Cleanup audio thread.
+*/
+static void AudioExitThread(void)
+{
+    void *retval;
+
+    Debug(3, "audio: %s\n", __FUNCTION__);
+
+    if (AudioThread) {
+        AudioThreadStop = 1;
+        AudioRunning = 1;               // wakeup thread, if needed
+        pthread_cond_signal(&AudioStartCond);
+        AudioWakeup();
+        if (pthread_join(AudioThread, &retval) || retval != PTHREAD_CANCELED) {
+            Error(_("audio: can't cancel play thread\n"));
+        }
+        pthread_cond_destroy(&AudioStartCond);
+        pthread_mutex_destroy(&AudioMutex);
+        AudioThread = 0;
+        if (AudioEventFd >= 0) {
+            close(AudioEventFd);
+            AudioEventFd = -1;
+        }
+    }
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+
+    /**
+    **	Table of all audio modules.
+    */
+static const AudioModule *AudioModules[] = {
+#ifdef USE_ALSA
+    &AlsaModule,
+#endif
+#ifdef USE_OSS
+    &OssModule,
+#endif
+    &NoopModule,
+};
+
+void AudioDelayms(int delayms)
+{
+    int count;
+    unsigned char *p;
+
+#ifdef DEBUG
+    printf("Try Delay Audio for %d ms  Samplerate %d Channels %d bps %d\n", delayms,
+        AudioRing[AudioRingWrite].HwSampleRate, AudioRing[AudioRingWrite].HwChannels,
+            AudioRing[AudioRingWrite].HwBytesProSample);
+#endif
+
+    count =
+        delayms * AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+            AudioRing[AudioRingWrite].HwBytesProSample /
+        1000;
+
+    if (delayms < 5000 && delayms > 0) {    // not more than 5seconds
+        p = calloc(1, count);
+        RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, p, count);
+        free(p);
+    }
+}
+
+/**
+**	Account samples placed in the ring buffer.
+**
+**	Starts the play thread, if enough is buffered and advances the
+**	audio clock.
+**
+**	@param count	number of bytes placed in ring buffer
+*/
+static void AudioEnqueueUpdate(int count)
+{
+    size_t n;
+
+    if (!AudioRunning) {                // check, if we can start the thread
+        int skip;
+
+        n = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
+        skip = AudioSkip;
+        // FIXME: round to packet size
+
+        Debug(4, "audio: start? %4zdms skip %dms\n", (n * 1000)
+            / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                AudioRing[AudioRingWrite].HwBytesProSample),
+            (skip * 1000)
+            / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                AudioRing[AudioRingWrite].HwBytesProSample));
+
+        if (skip) {
+            if (n < (unsigned)skip) {
+                skip = n;
+            }
+            AudioSkip -= skip;
+            RingBufferReadAdvance(AudioRing[AudioRingWrite].RingBuffer, skip);
+            n = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
+        }
+        // forced start or enough video + audio buffered
+        // for some exotic channels * 4 too small
+        if (AudioStartThreshold * 10 < n || (AudioVideoIsReady
+                //  if ((AudioVideoIsReady
+                && AudioStartThreshold < n)) {
+            // restart play-back
+            // no lock needed, can wakeup next time
+            AudioRunning = 1;
+            pthread_cond_signal(&AudioStartCond);
+            Debug(3, "Start on AudioEnque\n");
+        }
+    } else if (AudioStarved) {          // play thread waits for samples
+        AudioWakeup();
+    }
+    // Update audio clock (stupid gcc developers thinks INT64_C is unsigned)
+    if (AudioRing[AudioRingWrite].PTS != (int64_t) INT64_C(0x8000000000000000)) {
+        AudioRing[AudioRingWrite].PTS += ((int64_t) count * 90 * 1000)
+            / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                AudioRing[AudioRingWrite].HwBytesProSample);
+    }
+}
+
+/**
+**	Process int16 samples into hardware format.
+**
+**	Resample, compress, normalize and apply the software volume.
+**
+**	@param in	input sample buffer
+**	@param frames	number of frames in sample buffer
+**	@param out	output sample buffer
+*/
+static void AudioProcess(const int16_t * in, int frames, int16_t * out)
+{
+    int count;
+
+#ifdef USE_AUDIO_MIXER
+    // Convert / resample input to hardware format
+    AudioResample(in, AudioRing[AudioRingWrite].InChannels, frames, out, AudioRing[AudioRingWrite].HwChannels);
+#else
+    memcpy(out, in, frames * AudioRing[AudioRingWrite].InChannels * AudioBytesProSample);
+#endif
+    count = frames * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample;
+
+    if (AudioCompression) {             // in place operation
+        AudioCompressor(out, count);
+    }
+    if (AudioNormalize) {               // in place operation
+        AudioNormalizer(out, count);
+    }
+    AudioSoftAmplifier(out, frames, AudioRing[AudioRingWrite].HwChannels, AudioRing[AudioRingWrite].HwSampleRate);
+}
+
+/**
+**	Process samples straight into the ring buffer.
+**
+**	The samples are processed into the contiguous write region of the
+**	ring buffer, which is split at the ring buffer end.  Only a frame
+**	crossing the end is processed into a bounce buffer and copied.
+**	The caller accounts the samples with AudioEnqueueUpdate().
+**
+**	@param samples	sample buffer
+**	@param frames	number of frames in sample buffer
+**	@param matrix	float mix matrix or NULL for int16 samples
+*/
+static void AudioEnqueueFrames(const void *samples, int frames, const float (*matrix)[8])
+{
+    RingBuffer *rb;
+    const uint8_t *in;
+    int in_size;
+    int out_size;
+
+    rb = AudioRing[AudioRingWrite].RingBuffer;
+    in = samples;
+    in_size = AudioRing[AudioRingWrite].InChannels * (matrix ? (int)sizeof(float) : AudioBytesProSample);
+    out_size = AudioRing[AudioRingWrite].HwChannels * AudioRing[AudioRingWrite].HwBytesProSample;
+
+    while (frames > 0) {
+        uint8_t bounce[8 * 4];          // one frame 8ch 32bit
+        void *wp;
+        int n;
+
+        n = RingBufferGetWritePointer(rb, &wp) / out_size;
+        if (!n) {
+            if (RingBufferFreeBytes(rb) < (size_t)out_size) {
+                Error(_("audio: can't place %d samples in ring buffer\n"), frames * out_size);
+                // too many bytes are lost
+                // FIXME: caller checks buffer full.
+                // FIXME: should skip more, longer skip, but less often?
+                break;
+            }
+            wp = bounce;                // frame crosses ring buffer end
+            n = 1;
+        }
+        if (n > frames) {
+            n = frames;
+        }
+#ifdef USE_AUDIO_MIXER
+        if (matrix) {
+            AudioMixFloatKernel((const float *)in, AudioRing[AudioRingWrite].InChannels, n, wp,
+                AudioRing[AudioRingWrite].HwChannels, matrix, AudioRing[AudioRingWrite].HwFormat);
+        } else
+#endif
+            AudioProcess((const int16_t *)in, n, wp);
+        if (wp == bounce) {
+            RingBufferWrite(rb, bounce, out_size);
+            AudioCopies++;
+        } else {
+            RingBufferWriteAdvance(rb, n * out_size);
+        }
+        in += n * in_size;
+        frames -= n;
     }
-    return dummy;
 }
 
 /**
-**	Initialize audio thread.
+**	Place int16 samples in the ring buffer.
+**
+**	@param samples	sample buffer
+**	@param count	number of bytes in sample buffer
 */
-static void AudioInitThread(void)
+static void AudioEnqueueS16(const int16_t * samples, int count)
 {
-    AudioThreadStop = 0;
-    pthread_mutex_init(&AudioMutex, NULL);
-    pthread_cond_init(&AudioStartCond, NULL);
-    pthread_create(&AudioThread, NULL, AudioPlayHandlerThread, NULL);
-    pthread_setname_np(AudioThread, "softhddev audio");
-}
+    // audio sample modification allowed and needed?
+    if (!AudioRing[AudioRingWrite].Passthrough && (AudioCompression || AudioNormalize
+            || AudioRing[AudioRingWrite].InChannels != AudioRing[AudioRingWrite].HwChannels
+            || AudioSoftGain != 1.0f || AudioSoftTarget() != 1.0f)) {
+        int frames;
 
-/**
-**	Cleanup audio thread.
-*/
-static void AudioExitThread(void)
-{
-    void *retval;
+#if !defined(USE_AUDIO_MIXER) && defined(DEBUG)
+        if (AudioRing[AudioRingWrite].InChannels != AudioRing[AudioRingWrite].HwChannels) {
+            Debug(3, "audio: internal failure channels mismatch\n");
+            return;
+        }
+#endif
+        frames = count / (AudioRing[AudioRingWrite].InChannels * AudioBytesProSample);
+        AudioEnqueueFrames(samples, frames, NULL);
+        AudioEnqueueUpdate(frames * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample);
+        return;
+    }
+    // muting pass-through AC-3, can produce disturbance
+    if (AudioRing[AudioRingWrite].Passthrough && AudioMute) {
+        RingBuffer *rb;
+        int n;
 
-    Debug(3, "audio: %s\n", __FUNCTION__);
+        rb = AudioRing[AudioRingWrite].RingBuffer;
+        for (n = 0; n < count;) {
+            void *wp;
+            int i;
 
-    if (AudioThread) {
-        AudioThreadStop = 1;
-        AudioRunning = 1;               // wakeup thread, if needed
-        pthread_cond_signal(&AudioStartCond);
-        if (pthread_join(AudioThread, &retval) || retval != PTHREAD_CANCELED) {
-            Error(_("audio: can't cancel play thread\n"));
+            if (!(i = RingBufferGetWritePointer(rb, &wp))) {
+                Error(_("audio: can't place %d samples in ring buffer\n"), count - n);
+                break;
+            }
+            if (i > count - n) {
+                i = count - n;
+            }
+            memset(wp, 0, i);
+            RingBufferWriteAdvance(rb, i);
+            n += i;
         }
-        pthread_cond_destroy(&AudioStartCond);
-        pthread_mutex_destroy(&AudioMutex);
-        AudioThread = 0;
+    } else if (RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, samples, count) != (size_t)count) {
+        Error(_("audio: can't place %d samples in ring buffer\n"), count);
+        // FIXME: round to channel + sample border
     }
+    AudioEnqueueUpdate(count);
 }
 
-#endif
-
-//----------------------------------------------------------------------------
-//----------------------------------------------------------------------------
-
-    /**
-    **	Table of all audio modules.
-    */
-static const AudioModule *AudioModules[] = {
-#ifdef USE_ALSA
-    &AlsaModule,
-#endif
-#ifdef USE_OSS
-    &OssModule,
-#endif
-    &NoopModule,
-};
+#ifdef USE_AUDIO_MIXER
 
-void AudioDelayms(int delayms)
+/**
+**	Mix float samples into the ring buffer.
+**
+**	Compression, normalize and software volume are folded into the mix
+**	matrix, the mixer clips and converts to the hardware format in the
+**	same pass.  Software volume changes are ramped in steps of
+**	AUDIO_RAMP_FRAMES frames.
+**
+**	@param samples	sample buffer
+**	@param count	number of bytes in sample buffer
+*/
+static void AudioEnqueueMix(const float *samples, int count)
 {
-    int count;
-    unsigned char *p;
+    float matrix[8][8] __attribute__ ((aligned(16)));
+    float gain;
+    int in_chan;
+    int out_chan;
+    int frames;
+    int done;
 
-#ifdef DEBUG
-    printf("Try Delay Audio for %d ms  Samplerate %d Channels %d bps %d\n", delayms,
-        AudioRing[AudioRingWrite].HwSampleRate, AudioRing[AudioRingWrite].HwChannels, AudioBytesProSample);
-#endif
+    in_chan = AudioRing[AudioRingWrite].InChannels;
+    out_chan = AudioRing[AudioRingWrite].HwChannels;
+    frames = count / (in_chan * sizeof(*samples));
 
-    count =
-        delayms * AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample /
-        1000;
+    gain = 1.0f;
+    if (AudioCompression) {
+        gain = AudioCompressorFloat(samples, frames * in_chan);
+    }
+    if (AudioNormalize) {
+        gain *= AudioNormalizerFloat(samples, frames * in_chan, gain);
+    }
 
-    if (delayms < 5000 && delayms > 0) {    // not more than 5seconds
-        p = calloc(1, count);
-        RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, p, count);
-        free(p);
+    for (done = 0; done < frames;) {
+        float volume;
+        int n;
+        int i;
+        int o;
+
+        n = frames - done;
+        if (AudioSoftGain == AudioSoftTarget()) {
+            volume = AudioSoftGain;
+        } else {                        // ramp volume
+            if (n > AUDIO_RAMP_FRAMES) {
+                n = AUDIO_RAMP_FRAMES;
+            }
+            volume = AudioSoftRamp(n, AudioRing[AudioRingWrite].HwSampleRate);
+        }
+        for (i = 0; i < 8; ++i) {
+            for (o = 0; o < 8; ++o) {
+                matrix[i][o] = AudioMixGain[in_chan][out_chan][i][o] * gain * volume;
+            }
+        }
+        AudioEnqueueFrames(samples + done * in_chan, n, (const float (*)[8])matrix);
+        done += n;
     }
+    AudioEnqueueUpdate(frames * out_chan * AudioRing[AudioRingWrite].HwBytesProSample);
 }
 
+#endif
+
 /**
 **	Place samples in audio output queue.
 **
@@ -2197,9 +3405,6 @@ void AudioDelayms(int delayms)
 */
 void AudioEnqueue(const void *samples, int count)
 {
-    size_t n;
-    int16_t *buffer;
-
 #ifdef noDEBUG
     static uint32_t last_tick;
     uint32_t tick;
@@ -2220,85 +3425,108 @@ void AudioEnqueue(const void *samples, int count)
         AudioRing[AudioRingWrite].PacketSize = count;
         Debug(3, "audio: a/v packet size %d bytes\n", count);
     }
-    // audio sample modification allowed and needed?
-    buffer = (void *)samples;
-    if (!AudioRing[AudioRingWrite].Passthrough && (AudioCompression || AudioNormalize
-            || AudioRing[AudioRingWrite].InChannels != AudioRing[AudioRingWrite].HwChannels)) {
-        int frames;
-
-        // resample into ring-buffer is too complex in the case of a roundabout
-        // just use a temporary buffer
-        frames = count / (AudioRing[AudioRingWrite].InChannels * AudioBytesProSample);
-        buffer = alloca(frames * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample);
+    if (count) {
+        AudioPackets++;
+    }
 #ifdef USE_AUDIO_MIXER
-        // Convert / resample input to hardware format
-        AudioResample(samples, AudioRing[AudioRingWrite].InChannels, frames, buffer,
-            AudioRing[AudioRingWrite].HwChannels);
-#else
-#ifdef DEBUG
-        if (AudioRing[AudioRingWrite].InChannels != AudioRing[AudioRingWrite].HwChannels) {
-            Debug(3, "audio: internal failure channels mismatch\n");
-            return;
-        }
-#endif
-        memcpy(buffer, samples, count);
-#endif
-        count = frames * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample;
-
-        if (AudioCompression) {         // in place operation
-            AudioCompressor(buffer, count);
-        }
-        if (AudioNormalize) {           // in place operation
-            AudioNormalizer(buffer, count);
+    if (AudioRing[AudioRingWrite].Float) {  // float pipeline
+        float data[AUDIO_CHUNK_SAMPLES];
+        const int16_t *in;
+        int chunk;
+
+        // widen in chunks of whole frames
+        chunk = AUDIO_CHUNK_SAMPLES / AudioRing[AudioRingWrite].InChannels * AudioRing[AudioRingWrite].InChannels;
+        in = samples;
+        count /= AudioBytesProSample;
+        if (count) {
+            AudioCopies++;
         }
-    }
+        do {
+            int n;
+            int i;
 
-    n = RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, buffer, count);
-    if (n != (size_t)count) {
-        Error(_("audio: can't place %d samples in ring buffer\n"), count);
-        // too many bytes are lost
-        // FIXME: caller checks buffer full.
-        // FIXME: should skip more, longer skip, but less often?
-        // FIXME: round to channel + sample border
+            n = count < chunk ? count : chunk;
+            for (i = 0; i < n; ++i) {
+                data[i] = in[i] * (1.0f / 32768.0f);
+            }
+            AudioEnqueueMix(data, n * sizeof(*data));
+            in += n;
+            count -= n;
+        } while (count > 0);
+        return;
     }
+#endif
+    AudioEnqueueS16(samples, count);
+}
 
-    if (!AudioRunning) {                // check, if we can start the thread
-        int skip;
+/**
+**	Place float samples in audio output queue.
+**
+**	@param samples	sample buffer
+**	@param count	number of bytes in sample buffer
+*/
+void AudioEnqueueFloat(const float *samples, int count)
+{
+    int16_t data[AUDIO_CHUNK_SAMPLES];
+    int chunk;
 
-        n = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
-        skip = AudioSkip;
-        // FIXME: round to packet size
+    if (!AudioRing[AudioRingWrite].HwSampleRate) {
+        Debug(3, "audio: enqueue not ready\n");
+        return;                         // no setup yet
+    }
+    if (count) {
+        AudioPackets++;
+    }
+#ifdef USE_AUDIO_MIXER
+    if (AudioRing[AudioRingWrite].Float) {  // float pipeline
+        AudioEnqueueMix(samples, count);
+        return;
+    }
+#endif
+    // ring buffer was setup for int16 samples, narrow in chunks of whole frames
+    chunk = AUDIO_CHUNK_SAMPLES / AudioRing[AudioRingWrite].InChannels * AudioRing[AudioRingWrite].InChannels;
+    count /= sizeof(*samples);
+    if (count) {
+        AudioCopies++;
+    }
+    do {
+        int n;
+        int i;
 
-        Debug(4, "audio: start? %4zdms skip %dms\n", (n * 1000)
-            / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample),
-            (skip * 1000)
-            / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample));
+        n = count < chunk ? count : chunk;
+        for (i = 0; i < n; ++i) {
+            float t;
 
-        if (skip) {
-            if (n < (unsigned)skip) {
-                skip = n;
+            t = samples[i];
+            if (t < -1.0f) {
+                t = -1.0f;
+            } else if (t > 1.0f) {
+                t = 1.0f;
             }
-            AudioSkip -= skip;
-            RingBufferReadAdvance(AudioRing[AudioRingWrite].RingBuffer, skip);
-            n = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
+            data[i] = lrintf(t * 32767.0f);
         }
-        // forced start or enough video + audio buffered
-        // for some exotic channels * 4 too small
-        if (AudioStartThreshold * 10 < n || (AudioVideoIsReady
-                //  if ((AudioVideoIsReady
-                && AudioStartThreshold < n)) {
-            // restart play-back
-            // no lock needed, can wakeup next time
-            AudioRunning = 1;
-            pthread_cond_signal(&AudioStartCond);
-            Debug(3, "Start on AudioEnque\n");
-        }
-    }
-    // Update audio clock (stupid gcc developers thinks INT64_C is unsigned)
-    if (AudioRing[AudioRingWrite].PTS != (int64_t) INT64_C(0x8000000000000000)) {
-        AudioRing[AudioRingWrite].PTS += ((int64_t) count * 90 * 1000)
-            / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample);
-    }
+        AudioEnqueueS16(data, n * AudioBytesProSample);
+        samples += n;
+        count -= n;
+    } while (count > 0);
+}
+
+/**
+**	Get audio enqueue and play thread statistics.
+**
+**	@param[out] packets	packets enqueued
+**	@param[out] copies	extra copies through temporary buffers
+**	@param[out] wakeups	play thread wakeups by commands
+**	@param[out] latency	max. command to play thread latency in us
+**	@param[out] start	last flush (zap) to play start latency in ms
+*/
+void AudioGetStats(int *packets, int *copies, int *wakeups, int *latency, int *start)
+{
+    *packets = AudioPackets;
+    *copies = AudioCopies;
+    *wakeups = AudioWakeups;
+    *latency = AudioWakeupLatency;
+    *start = AudioStartLatency;
 }
 
 /**
@@ -2328,12 +3556,12 @@ void AudioVideoReady(int64_t pts)
     audio_pts =
         AudioRing[AudioRingWrite].PTS -
         (used * 90 * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
-        AudioBytesProSample);
+        AudioRing[AudioRingWrite].HwBytesProSample);
 
     Debug(3, "audio: a/v sync buf(%d,%4zdms) %s | %s = %dms %s\n", atomic_read(&AudioRingFilled),
         (used * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
-            AudioBytesProSample), Timestamp2String(pts), Timestamp2String(audio_pts), (int)(pts - audio_pts) / 90,
-        AudioRunning ? "running" : "ready");
+            AudioRing[AudioRingWrite].HwBytesProSample), Timestamp2String(pts), Timestamp2String(audio_pts),
+        (int)(pts - audio_pts) / 90, AudioRunning ? "running" : "ready");
 
     if (!AudioRunning) {
         int skip;
@@ -2347,7 +3575,7 @@ void AudioVideoReady(int64_t pts)
         // guard against old PTS
         if (skip > 0 && skip < 4000 * 90) {
             skip = (((int64_t) skip * AudioRing[AudioRingWrite].HwSampleRate) / (1000 * 90))
-                * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample;
+                * AudioRing[AudioRingWrite].HwChannels * AudioRing[AudioRingWrite].HwBytesProSample;
             // FIXME: round to packet size
             if ((unsigned)skip > used) {
                 AudioSkip = skip - used;
@@ -2355,7 +3583,7 @@ void AudioVideoReady(int64_t pts)
             }
             Debug(3, "audio: sync advance %dms %d/%zd\n",
                 (skip * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
-                    AudioBytesProSample), skip, used);
+                    AudioRing[AudioRingWrite].HwBytesProSample), skip, used);
             RingBufferReadAdvance(AudioRing[AudioRingWrite].RingBuffer, skip);
 
             used = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
@@ -2382,7 +3610,8 @@ void AudioVideoReady(int64_t pts)
         }
         Debug(3, "audio: start %4zdms %s|%s video ready\n",
             (RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer) * 1000)
-            / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample),
+            / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                AudioRing[AudioRingWrite].HwBytesProSample),
             Timestamp2String(pts), Timestamp2String(AudioRing[AudioRingWrite].PTS));
 
         if (!AudioRunning) {
@@ -2395,7 +3624,7 @@ void AudioVideoReady(int64_t pts)
                 if (AudioStartThreshold < used) {
                     Debug(3, "audio: start %4zdms skip video ready\n", ((used - AudioStartThreshold) * 1000)
                         / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
-                            AudioBytesProSample));
+                            AudioRing[AudioRingWrite].HwBytesProSample));
                     RingBufferReadAdvance(AudioRing[AudioRingWrite].RingBuffer, used - AudioStartThreshold);
                 }
                 AudioRunning = 1;
@@ -2445,8 +3674,10 @@ void AudioFlushBuffers(void)
     Debug(3, "audio: reset video ready\n");
     AudioVideoIsReady = 0;
     AudioSkip = 0;
+    AudioFlushTime = GetMsTicks() | 1;
 
     atomic_inc(&AudioRingFilled);
+    AudioWakeup();                      // running thread flushes at once
 
     // FIXME: wait for flush complete needed?
     for (i = 0; i < 24 * 2; ++i) {
@@ -2511,7 +3742,7 @@ int64_t AudioGetDelay(void)
     pts = AudioUsedModule->GetDelay();
     pts += ((int64_t) RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer)
         * 90 * 1000) / (AudioRing[AudioRingRead].HwSampleRate * AudioRing[AudioRingRead].HwChannels *
-        AudioBytesProSample);
+        AudioRing[AudioRingRead].HwBytesProSample);
     Debug(4, "audio: hw+sw delay %zd %" PRId64 "ms\n", RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer),
         pts / 90);
 
@@ -2535,14 +3766,23 @@ void AudioSetClock(int64_t pts)
 /**
 **	Get current audio clock.
 **
+**	Uses the filtered audio clock, if locked, otherwise the current
+**	delay.
+**
 **	@returns the audio clock in time stamps.
 */
 int64_t AudioGetClock(void)
 {
     // (cast) needed for the evil gcc
     if (AudioRing[AudioRingRead].PTS != (int64_t) INT64_C(0x8000000000000000)) {
+        AudioClockDll clock;
         int64_t delay;
 
+        // filtered clock, running from the last paired sample
+        if (AudioRunning && !AudioPaused && AudioClockRead(&clock)) {
+            return clock.PTS + clock.Rate * (double)(AudioGetUs() - clock.Time);
+        }
+
         // delay zero, if no valid time stamp
         if ((delay = AudioGetDelay())) {
             if (AudioRing[AudioRingRead].Passthrough) {
@@ -2554,6 +3794,22 @@ int64_t AudioGetClock(void)
     return INT64_C(0x8000000000000000);
 }
 
+/**
+**	Get audio clock drift.
+**
+**	@returns rate of the audio clock against the monotonic clock in ppm,
+**	0 while the clock isn't locked some seconds.
+*/
+int AudioGetClockDrift(void)
+{
+    AudioClockDll clock;
+
+    if (!AudioClockRead(&clock) || clock.Time - clock.Locked < 5 * 1000 * 1000) {
+        return 0;
+    }
+    return lrint((clock.Rate / (90.0 / 1000.0) - 1.0) * 1000 * 1000);
+}
+
 /**
 **	Set mixer volume (0-1000)
 **
@@ -2629,6 +3885,7 @@ void AudioPause(void)
     }
     Debug(3, "audio: paused\n");
     AudioPaused = 1;
+    AudioWakeup();
 }
 
 /**
@@ -2661,6 +3918,32 @@ void AudioSetSoftvol(int onoff)
     }
 }
 
+/**
+**	Enable/disable float sample pipeline.
+**
+**	Takes effect with the next audio format setup.
+**
+**	@param onoff	-1 toggle, true turn on, false turn off
+*/
+void AudioSetFloat(int onoff)
+{
+    if (onoff < 0) {
+        AudioFloat ^= 1;
+    } else {
+        AudioFloat = onoff;
+    }
+}
+
+/**
+**	Check if float samples should be enqueued.
+**
+**	@returns true, if the current ring buffer uses the float pipeline.
+*/
+int AudioUseFloat(void)
+{
+    return AudioRing[AudioRingWrite].Float;
+}
+
 /**
 **	Set normalize volume parameters.
 **
@@ -2932,6 +4215,32 @@ void AudioInit(void)
             }
         }
     }
+#ifdef USE_AUDIO_MIXER
+    AudioMixerInit();
+    //  best pcm sample format for the float pipeline
+    AudioHwFormat = AudioFormatS16;
+    for (chan = 1; chan < 9 && !(AudioRatesInHw[Audio48000] & (1 << chan)); ++chan) {
+    }
+    if (chan < 9) {
+        int format;
+
+        for (format = AudioFormatFloat; format > AudioFormatS16; --format) {
+            int tchan;
+            int tfreq;
+
+            tchan = chan;
+            tfreq = 48000;
+            AudioRing[AudioRingRead].HwFormat = format;
+            if (!AudioUsedModule->Setup(&tfreq, &tchan, 0)) {
+                AudioHwFormat = format;
+                break;
+            }
+        }
+        AudioRing[AudioRingRead].HwFormat = AudioFormatS16;
+    }
+    Info(_("audio: float pipeline plays %s samples\n"),
+        AudioHwFormat == AudioFormatFloat ? "float" : AudioHwFormat == AudioFormatS32 ? "32 bit" : "16 bit");
+#endif
     for (u = 0; u < AudioRatesMax; ++u) {
         Info(_("audio: %6dHz supports %d %d %d %d %d %d %d %d channels\n"), AudioRatesTable[u],
             AudioChannelMatrix[u][1], AudioChannelMatrix[u][2], AudioChannelMatrix[u][3], AudioChannelMatrix[u][4],
@@ -3100,3 +4409,138 @@ int main(int argc, char *const argv[])
 }
 
 #endif
+
+#ifdef AUDIO_CLOCK_TEST
+
+//----------------------------------------------------------------------------
+//  Test audio clock
+//----------------------------------------------------------------------------
+
+int SysLogLevel;                        ///< show only errors
+
+/**
+**	Simulate the audio clock loop with the drift correction.
+**
+**	The device plays with the given drift against the monotonic clock.
+**	Each period the play thread reports the delay with jitter, once a
+**	second the integral controller of CodecAudioSetClock() adds 0.03 of
+**	the reported drift to the resample compensation, which slows the
+**	played time stamps.
+**
+**	@param ppm	device clock drift in ppm
+**	@param jitter	max. delay jitter in ms
+**	@param seconds	simulated time in seconds
+**
+**	@returns 0 if the loop settles without oscillation, -1 otherwise.
+*/
+static int AudioClockTestRun(double ppm, int jitter, int seconds)
+{
+    const int64_t delay = 100 * 90;     // 100ms device delay
+    uint64_t time;
+    uint64_t next;
+    double position;
+    double comp;
+    double pos_err;
+    double rate_err;
+    double overshoot;
+    int settled;
+
+    AudioClockReset();
+    AudioRing[AudioRingRead].PTS = 0;
+    time = 1000 * 1000;
+    next = time + 1000 * 1000;
+    position = 0.0;
+    comp = 0.0;
+    pos_err = 0.0;
+    rate_err = 0.0;
+    overshoot = 0.0;
+    settled = -1;
+
+    while (time < (uint64_t) seconds * 1000 * 1000) {
+        uint64_t dt;
+        double j;
+
+        // play thread period 20-28ms, delay jitter uniform
+        dt = 20 * 1000 + random() % (8 * 1000);
+        time += dt;
+        position += 90.0 / 1000.0 * (1.0 + (ppm - comp) / 1e6) * dt;
+        AudioRing[AudioRingRead].PTS = position + delay;
+        j = (random() % (2 * jitter * 90 + 1)) - jitter * 90;
+        AudioClockUpdate(delay + j, time);
+
+        if (time >= next) {             // drift correction once a second
+            double drift;
+
+            next += 1000 * 1000;
+            drift = 0.0;
+            if (AudioClock.Valid && AudioClock.Time - AudioClock.Locked >= 5 * 1000 * 1000) {
+                drift = (AudioClock.Rate / (90.0 / 1000.0) - 1.0) * 1e6;
+            }
+            comp += 0.03 * drift;
+            if (comp < -5000) {         // limit 0.5%
+                comp = -5000;
+            } else if (comp > 5000) {
+                comp = 5000;
+            }
+            // residual drift after the compensation
+            if (fabs(ppm - comp) > 10.0) {
+                settled = -1;
+            } else if (settled < 0) {
+                settled = time / (1000 * 1000);
+            }
+            if (ppm && (comp - ppm) / ppm > overshoot) {
+                overshoot = (comp - ppm) / ppm;
+            }
+            // errors over the second half of the run
+            if (time > (uint64_t) seconds * 1000 * 1000 / 2) {
+                if (fabs(AudioClock.PTS - position) > pos_err) {
+                    pos_err = fabs(AudioClock.PTS - position);
+                }
+                if (fabs(ppm - comp) > rate_err) {
+                    rate_err = fabs(ppm - comp);
+                }
+            }
+        }
+    }
+
+    printf("%+6.0fppm +-%dms: settled after %3ds, overshoot %4.1f%%, position %.2fms, drift %.1fppm\n", ppm,
+        jitter, settled, overshoot * 100.0, pos_err / 90, rate_err);
+
+    return settled < 0 || settled > seconds / 2 || overshoot > 0.1 || pos_err > 90 || rate_err > 10.0 ? -1 : 0;
+}
+
+/**
+**	Main entry point.
+**
+**	audio_clock_test
+**
+**	Runs the audio clock loop with drift correction for some device
+**	clock drifts and delay jitters and checks, that the compensation
+**	settles within 10ppm in half the run with less than 10% overshoot
+**	and the filtered position stays within 1ms.
+*/
+int main(void)
+{
+    static const double ppm[] = { 0, 100, -100, 300, -1000 };
+    int err;
+    int i;
+    int j;
+
+    AudioRing[AudioRingRead].HwSampleRate = 48000;
+    AudioRing[AudioRingRead].HwChannels = 2;
+    AudioRing[AudioRingRead].HwBytesProSample = 2;
+    AudioRing[AudioRingRead].RingBuffer = RingBufferNew(4096);
+
+    err = 0;
+    srandom(1);
+    for (i = 0; i < (int)(sizeof(ppm) / sizeof(*ppm)); ++i) {
+        for (j = 1; j <= 4; j *= 2) {
+            err |= AudioClockTestRun(ppm[i], j, 300);
+        }
+    }
+    RingBufferDel(AudioRing[AudioRingRead].RingBuffer);
+
+    return err;
+}
+
+#endif
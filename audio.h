@@ -28,6 +28,7 @@
 //----------------------------------------------------------------------------
 
 extern void AudioEnqueue(const void *, int);    ///< buffer audio samples
+extern void AudioEnqueueFloat(const float *, int);  ///< buffer float samples
 extern void AudioFlushBuffers(void);    ///< flush audio buffers
 extern void AudioPoller(void);          ///< poll audio events/handling
 extern int AudioFreeBytes(void);        ///< free bytes in audio output
@@ -35,6 +36,8 @@ extern int AudioUsedBytes(void);        ///< used bytes in audio output
 extern int64_t AudioGetDelay(void);     ///< get current audio delay
 extern void AudioSetClock(int64_t);     ///< set audio clock base
 extern int64_t AudioGetClock();         ///< get current audio clock
+extern int AudioGetClockDrift(void);    ///< get audio clock drift in ppm
+extern void AudioGetStats(int *, int *, int *, int *, int *);  ///< get enqueue statistics
 extern void AudioSetVolume(int);        ///< set volume
 extern int AudioSetup(int *, int *, int);   ///< setup audio output
 
@@ -43,6 +46,8 @@ extern void AudioPause(void);           ///< pause audio
 
 extern void AudioSetBufferTime(int);    ///< set audio buffer time
 extern void AudioSetSoftvol(int);       ///< enable/disable softvol
+extern void AudioSetFloat(int);         ///< enable/disable float pipeline
+extern int AudioUseFloat(void);         ///< float samples wanted
 extern void AudioSetNormalize(int, int);    ///< set normalize parameters
 extern void AudioSetCompression(int, int);  ///< set compression parameters
 extern void AudioSetStereoDescent(int); ///< set stereo loudness descent
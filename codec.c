@@ -98,6 +98,9 @@ static pthread_mutex_t CodecLockMutex;
 
 /// Flag prefer fast channel switch
 char CodecUsePossibleDefectFrames;
+
+/// Number of software video decoder threads, 0 all cpus
+int CodecVideoThreads;
 AVBufferRef *hw_device_ctx;
 
 //----------------------------------------------------------------------------
@@ -149,6 +152,14 @@ static enum AVPixelFormat Codec_get_format(AVCodecContext * video_ctx, const enu
         Error("codec/video: ffmpeg/libav buggy: width or height zero\n");
     }
 
+    if (decoder->CacheHit) {            // reused context, log format changes
+        decoder->CacheHit = 0;
+        if (video_ctx->profile != decoder->CacheKey.Profile || video_ctx->width != decoder->CacheKey.Width
+            || video_ctx->height != decoder->CacheKey.Height || video_ctx->sw_pix_fmt != decoder->CacheKey.PixFmt) {
+            Info(_("codec: warm decoder format changed %dx%d -> %dx%d\n"), decoder->CacheKey.Width,
+                decoder->CacheKey.Height, video_ctx->width, video_ctx->height);
+        }
+    }
     //  decoder->GetFormatDone = 1;
     return Video_get_format(decoder->HwDecoder, video_ctx, fmt);
 
@@ -213,6 +224,100 @@ VideoDecoder *CodecVideoNewDecoder(VideoHwDecoder * hw_decoder)
     return decoder;
 }
 
+/**
+**  Close an idle video decoder context of the cache.
+**
+**  @param cache    cache entry
+*/
+static void CodecVideoCacheFree(VideoCodecCache * cache)
+{
+    pthread_mutex_lock(&CodecLockMutex);
+    avcodec_close(cache->VideoCtx);
+    av_freep(&cache->VideoCtx->extradata);
+    av_freep(&cache->VideoCtx);
+    pthread_mutex_unlock(&CodecLockMutex);
+}
+
+/**
+**  Keep the drained codec context of the decoder for the next stream.
+**
+**  The least recently used idle context is closed, if the cache is
+**  full.  Each hw decoder context holds a decoder session and surfaces
+**  on the gpu, only one of them is kept.
+**
+**  @param decoder  private video decoder
+**
+**  @returns true if the context is cached, false if it must be closed.
+*/
+static int CodecVideoCachePut(VideoDecoder * decoder)
+{
+    AVCodecContext *video_ctx;
+    VideoCodecCache *cache;
+    int i;
+
+    video_ctx = decoder->VideoCtx;
+    if (!video_ctx->width || !video_ctx->height) {  // nothing decoded
+        return 0;
+    }
+    if ((decoder->VideoCodec->capabilities & AV_CODEC_CAP_HARDWARE) || video_ctx->hw_device_ctx) {
+        for (i = 0; i < CODEC_VIDEO_CACHE_MAX; ++i) {
+            if (decoder->Cache[i].VideoCtx) {
+                Debug(3, "codec: close idle %s decoder %dx%d\n", decoder->Cache[i].VideoCodec->name,
+                    decoder->Cache[i].Width, decoder->Cache[i].Height);
+                CodecVideoCacheFree(decoder->Cache + i);
+            }
+        }
+    }
+    cache = decoder->Cache;
+    for (i = 1; cache->VideoCtx && i < CODEC_VIDEO_CACHE_MAX; ++i) {
+        if (!decoder->Cache[i].VideoCtx || decoder->Cache[i].LastUse < cache->LastUse) {
+            cache = decoder->Cache + i;
+        }
+    }
+    if (cache->VideoCtx) {
+        Debug(3, "codec: close idle %s decoder %dx%d\n", cache->VideoCodec->name, cache->Width, cache->Height);
+        CodecVideoCacheFree(cache);
+    }
+
+    // drop the packets (arena references) and frames of the old stream
+    avcodec_flush_buffers(video_ctx);
+    VideoFilterRelease(decoder->HwDecoder);
+    video_ctx->skip_frame = AVDISCARD_DEFAULT;
+    cache->VideoCtx = video_ctx;
+    cache->VideoCodec = decoder->VideoCodec;
+    cache->Profile = video_ctx->profile;
+    cache->Width = video_ctx->width;
+    cache->Height = video_ctx->height;
+    cache->PixFmt = video_ctx->sw_pix_fmt;
+    cache->Filter = decoder->filter;
+    cache->LastUse = ++decoder->CacheUse;
+
+    return 1;
+}
+
+/**
+**  Get the most recently used idle context of the codec.
+**
+**  @param decoder  private video decoder
+**  @param codec    codec to open
+**
+**  @returns cache entry, NULL if there is no idle context of the codec.
+*/
+static VideoCodecCache *CodecVideoCacheGet(VideoDecoder * decoder, const AVCodec * codec)
+{
+    VideoCodecCache *cache;
+    int i;
+
+    cache = NULL;
+    for (i = 0; i < CODEC_VIDEO_CACHE_MAX; ++i) {
+        if (decoder->Cache[i].VideoCtx && decoder->Cache[i].VideoCodec == codec && (!cache
+                || decoder->Cache[i].LastUse > cache->LastUse)) {
+            cache = decoder->Cache + i;
+        }
+    }
+    return cache;
+}
+
 /**
 **  Deallocate a video decoder context.
 **
@@ -220,9 +325,34 @@ VideoDecoder *CodecVideoNewDecoder(VideoHwDecoder * hw_decoder)
 */
 void CodecVideoDelDecoder(VideoDecoder * decoder)
 {
+    int i;
+
+    for (i = 0; i < CODEC_VIDEO_CACHE_MAX; ++i) {
+        if (decoder->Cache[i].VideoCtx) {
+            CodecVideoCacheFree(decoder->Cache + i);
+        }
+    }
+    av_freep(&decoder->Extradata);
     free(decoder);
 }
 
+/**
+**  Set extradata for the next open of the video decoder.
+**
+**  @param decoder  private video decoder
+**  @param data     codec extradata (f.e. annex b parameter sets)
+**  @param size     size of extradata
+*/
+void CodecVideoSetExtradata(VideoDecoder * decoder, const uint8_t * data, int size)
+{
+    av_freep(&decoder->Extradata);
+    decoder->ExtradataSize = 0;
+    if ((decoder->Extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE))) {
+        memcpy(decoder->Extradata, data, size);
+        decoder->ExtradataSize = size;
+    }
+}
+
 /**
 **  Open video decoder.
 **
@@ -232,6 +362,7 @@ void CodecVideoDelDecoder(VideoDecoder * decoder)
 void CodecVideoOpen(VideoDecoder * decoder, int codec_id)
 {
     AVCodec *video_codec;
+    VideoCodecCache *cache;
     const char *name;
     int ret, deint = 2;
 
@@ -241,6 +372,8 @@ void CodecVideoOpen(VideoDecoder * decoder, int codec_id)
     if (decoder->VideoCtx) {
         Error(_("codec: missing close\n"));
     }
+    // new stream starts here, also for a warm decoder without get_format
+    VideoZapStarted();
 
     name = "NULL";
 #ifdef CUVID
@@ -269,15 +402,46 @@ void CodecVideoOpen(VideoDecoder * decoder, int codec_id)
 
     Debug(3, "codec: video '%s'\n", decoder->VideoCodec->long_name);
 
+    if ((cache = CodecVideoCacheGet(decoder, video_codec))) {
+        ret = 0;
+        if (decoder->Extradata) {       // cached parameter sets in-band
+            AVPacket avpkt[1];
+
+            av_init_packet(avpkt);
+            avpkt->data = decoder->Extradata;
+            avpkt->size = decoder->ExtradataSize;
+            ret = avcodec_send_packet(cache->VideoCtx, avpkt);
+        }
+        if (ret < 0) {
+            Debug(3, "codec: warm %s decoder refused parameter sets %d\n", video_codec->name, ret);
+            CodecVideoCacheFree(cache);
+        } else {
+            // warm context: only flushed, hw decoder and surfaces are kept
+            Info(_("codec: reuse warm %s decoder, last stream %dx%d\n"), video_codec->name, cache->Width,
+                cache->Height);
+            decoder->VideoCtx = cache->VideoCtx;
+            decoder->CacheKey = *cache;
+            decoder->CacheHit = 1;
+            cache->VideoCtx = NULL;
+            av_freep(&decoder->Extradata);
+            decoder->ExtradataSize = 0;
+
+            // get_format isn't called, if the stream format is unchanged
+            decoder->GetFormatDone = 0;
+            decoder->filter = cache->Filter ? 1 : 0;    // init deint filter again
+            VideoWarmStart(decoder->HwDecoder);
+            return;
+        }
+    }
+    Debug(3, "codec: no warm %s decoder, open new context\n", video_codec->name);
+    decoder->CacheHit = 0;
+
     if (!(decoder->VideoCtx = avcodec_alloc_context3(video_codec))) {
         Fatal(_("codec: can't allocate video codec context\n"));
     }
-    if (!HwDeviceContext) {
-        Fatal("codec: no hw device context to be used");
+    if (HwDeviceContext) {
+        decoder->VideoCtx->hw_device_ctx = av_buffer_ref(HwDeviceContext);
     }
-    decoder->VideoCtx->hw_device_ctx = av_buffer_ref(HwDeviceContext);
-
-    // FIXME: for software decoder use all cpus, otherwise 1
     decoder->VideoCtx->thread_count = 1;
 
     decoder->VideoCtx->pkt_timebase.num = 1;
@@ -285,6 +449,13 @@ void CodecVideoOpen(VideoDecoder * decoder, int codec_id)
     decoder->VideoCtx->framerate.num = 50;
     decoder->VideoCtx->framerate.den = 1;
 
+    if (decoder->Extradata) {           // context owns the extradata now
+        decoder->VideoCtx->extradata = decoder->Extradata;
+        decoder->VideoCtx->extradata_size = decoder->ExtradataSize;
+        decoder->Extradata = NULL;
+        decoder->ExtradataSize = 0;
+    }
+
     pthread_mutex_lock(&CodecLockMutex);
     // open codec
 #ifdef YADIF
@@ -319,6 +490,11 @@ void CodecVideoOpen(VideoDecoder * decoder, int codec_id)
         Fatal(_("VAAPI Refcounts invalid\n"));
     decoder->VideoCtx->thread_safe_callbacks = 0;
 #endif
+    if (!HwDeviceContext) {             // software decoder, use frame and slice threads
+        Debug(3, "codec: software decoder with %d threads\n", CodecVideoThreads);
+        decoder->VideoCtx->thread_count = CodecVideoThreads;
+        decoder->VideoCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
 
 #ifdef CUVID
     if (strcmp(decoder->VideoCodec->long_name, "Nvidia CUVID MPEG2VIDEO decoder") == 0) {   // deinterlace for mpeg2 is somehow broken
@@ -413,7 +589,16 @@ void CodecVideoClose(VideoDecoder * video_decoder)
         while (avcodec_receive_frame(video_decoder->VideoCtx, frame) >= 0) ;
         av_frame_free(&frame);
 #endif
+        pthread_mutex_unlock(&CodecLockMutex);
+
+        // keep context open for the next stream with the same codec
+        if (CodecVideoCachePut(video_decoder)) {
+            video_decoder->VideoCtx = NULL;
+            return;
+        }
+        pthread_mutex_lock(&CodecLockMutex);
         avcodec_close(video_decoder->VideoCtx);
+        av_freep(&video_decoder->VideoCtx->extradata);
         av_freep(&video_decoder->VideoCtx);
         pthread_mutex_unlock(&CodecLockMutex);
     }
@@ -486,13 +671,13 @@ void CodecVideoDecode(VideoDecoder * decoder, const AVPacket * avpkt)
         } 
 		
 		if (!CuvidTestSurfaces())
-        	usleep(1000);
+        	VideoDecoderWait(20);       // wait for free surface
 		
-        frame = av_frame_alloc();
+        frame = VideoFrameGet();        // owned by the renderer after render
         ret = avcodec_receive_frame(video_ctx, frame);
         if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
             Debug(4, "codec: receiving video frame failed");
-            av_frame_free(&frame);
+            VideoFrameRelease(&frame);
             return;
         }
         if (ret >= 0) {
@@ -513,7 +698,7 @@ void CodecVideoDecode(VideoDecoder * decoder, const AVPacket * avpkt)
             }
             VideoRenderFrame(decoder->HwDecoder, video_ctx, frame);
         } else {
-            av_frame_free(&frame);
+            VideoFrameRelease(&frame);
         }
     }
 }
@@ -546,14 +731,14 @@ void CodecVideoDecode(VideoDecoder * decoder, const AVPacket * avpkt)
     }
 
     if (!CuvidTestSurfaces())
-        usleep(1000);
+        VideoDecoderWait(20);           // wait for free surface
 
     // printf("send packet to decode %s\n",consumed?"ok":"Full");
 
     if ((ret1 == AVERROR(EAGAIN) || ret1 == AVERROR_EOF || ret1 >= 0) && CuvidTestSurfaces()) {
         ret = 0;
         while ((ret >= 0) && CuvidTestSurfaces()) { // get frames until empty snd Surfaces avail.
-            frame = av_frame_alloc();
+            frame = VideoFrameGet();    // owned by the renderer after render
             ret = avcodec_receive_frame(video_ctx, frame);  // get new frame
             if (ret >= 0) {             // one is avail.
                 got_frame = 1;
@@ -584,12 +769,12 @@ void CodecVideoDecode(VideoDecoder * decoder, const AVPacket * avpkt)
                 VideoRenderFrame(decoder->HwDecoder, video_ctx, frame);
                 // av_frame_unref(frame);
             } else {
-                av_frame_free(&frame);
+                VideoFrameRelease(&frame);
                 // printf("codec: got no frame %d  send %d\n",ret,ret1);
             }
         }
         if (!CuvidTestSurfaces()) {
-            usleep(1000);
+            VideoDecoderWait(20);       // wait for free surface
         }
     } else {
         // consumed = 1;
@@ -602,6 +787,19 @@ void CodecVideoDecode(VideoDecoder * decoder, const AVPacket * avpkt)
 }
 #endif
 
+/**
+**  Set which pictures the video decoder discards.
+**
+**  @param decoder  video decoder data
+**  @param discard  AVDISCARD_DEFAULT, AVDISCARD_NONREF, AVDISCARD_BIDIR, ...
+*/
+void CodecVideoSetDiscard(VideoDecoder * decoder, int discard)
+{
+    if (decoder && decoder->VideoCtx) {
+        decoder->VideoCtx->skip_frame = discard;
+    }
+}
+
 /**
 **  Flush the video decoder.
 **
@@ -655,6 +853,12 @@ struct _audio_decoder_
 #ifdef USE_AVRESAMPLE
     AVAudioResampleContext *Resample;   ///< libav software resample context
 #endif
+    char Reordered;                     ///< resample outputs alsa channel order
+    char Float;                         ///< resample outputs float samples
+#ifdef DEBUG
+    uint64_t ConvertTime;               ///< ns spent in sample conversion
+    uint32_t ConvertSamples;            ///< samples converted
+#endif
 
     uint16_t Spdif[24576 / 2];          ///< SPDIF output buffer
     int SpdifIndex;                     ///< index into SPDIF output buffer
@@ -667,6 +871,10 @@ struct _audio_decoder_
     int Drift;                          ///< accumulated audio drift
     int DriftCorr;                      ///< audio drift correction value
     int DriftFrac;                      ///< audio drift fraction for ac3
+    int64_t DriftRest;                  ///< remainder of drift correction
+    int SyncCorr;                       ///< video master sync integral part
+    char SyncMaster;                    ///< video master sync active
+    int BurstHold;                      ///< bursts until next burst sync step
 
 #if !defined(USE_SWRESAMPLE) && !defined(USE_AVRESAMPLE)
     struct AVResampleContext *AvResample;   ///< second audio resample context
@@ -934,6 +1142,38 @@ static void CodecReorderAudioFrame(int16_t * buf, int size, int channels)
     }
 }
 
+#if defined(USE_SWRESAMPLE) || defined(USE_AVRESAMPLE)
+
+/**
+**  Get resampler channel map for ffmpeg -> alsa channel order.
+**
+**  The same reorder as CodecReorderAudioFrame, done by the resampler
+**  while it interleaves the samples.  The map has the input channel
+**  for each output channel, swresample keeps the pointer.
+**
+**  @param channels     number of channels
+**
+**  @returns channel map, NULL if no reorder is needed.
+*/
+static const int *CodecAudioChannelMap(int channels)
+{
+    static const int map5[] = { 0, 1, 3, 4, 2 };
+    static const int map6[] = { 0, 1, 4, 5, 2, 3 };
+    static const int map8[] = { 0, 1, 4, 5, 2, 3, 6, 7 };
+
+    switch (channels) {
+        case 5:
+            return map5;
+        case 6:
+            return map6;
+        case 8:
+            return map8;
+    }
+    return NULL;
+}
+
+#endif
+
 /**
 **  Handle audio format changes helper.
 **
@@ -994,6 +1234,48 @@ static int CodecAudioUpdateHelper(AudioDecoder * audio_decoder, int *passthrough
     return 0;
 }
 
+#ifdef USE_PASSTHROUGH
+
+/**
+**  Video master sync of pass-through audio.
+**
+**  IEC 61937 bursts can't be resampled.  If the audio/video difference
+**  grows over one and a half burst, a burst is dropped or repeated.
+**
+**  @param audio_decoder    audio decoder data
+**  @param spdif_sz         size of the burst in bytes
+**
+**  @returns how often the burst must be played.
+*/
+static int CodecAudioBurstSync(AudioDecoder * audio_decoder, int spdif_sz)
+{
+    int diff;
+    int duration;
+
+    if (!VideoGetMasterSyncDiff(&diff)) {
+        audio_decoder->BurstHold = 0;
+        return 1;
+    }
+    if (audio_decoder->BurstHold > 0) { // wait until the difference follows
+        --audio_decoder->BurstHold;
+        return 1;
+    }
+    // burst duration in pts
+    duration = ((int64_t) spdif_sz / (2 * audio_decoder->HwChannels)) * 90000 / audio_decoder->HwSampleRate;
+    if (abs(diff) <= duration * 3 / 2) {
+        return 1;
+    }
+    audio_decoder->BurstHold = 90000 / duration;    // hold 1s
+    if (diff > 0) {
+        Debug(3, "codec/audio: audio late %dms, dropping burst\n", diff / 90);
+        return 0;
+    }
+    Debug(3, "codec/audio: audio early %dms, repeating burst\n", -diff / 90);
+    return 2;
+}
+
+#endif
+
 /**
 **  Audio pass-through decoder helper.
 **
@@ -1004,6 +1286,7 @@ static int CodecAudioPassthroughHelper(AudioDecoder * audio_decoder, const AVPac
 {
 #ifdef USE_PASSTHROUGH
     const AVCodecContext *audio_ctx;
+    int n;
 
     audio_ctx = audio_decoder->AudioCtx;
     // SPDIF/HDMI passthrough
@@ -1052,7 +1335,9 @@ static int CodecAudioPassthroughHelper(AudioDecoder * audio_decoder, const AVPac
         // FIXME: don't need to clear always
         memset(spdif + 4 + avpkt->size / 2, 0, spdif_sz - 8 - avpkt->size);
         // don't play with the ac-3 samples
-        AudioEnqueue(spdif, spdif_sz);
+        for (n = CodecAudioBurstSync(audio_decoder, spdif_sz); n > 0; --n) {
+            AudioEnqueue(spdif, spdif_sz);
+        }
         return 1;
     }
     if (CodecPassthrough & CodecEAC3 && audio_ctx->codec_id == AV_CODEC_ID_EAC3) {
@@ -1097,7 +1382,9 @@ static int CodecAudioPassthroughHelper(AudioDecoder * audio_decoder, const AVPac
         memset(spdif + 4 + audio_decoder->SpdifIndex / 2, 0, spdif_sz - 8 - audio_decoder->SpdifIndex);
 
         // don't play with the eac-3 samples
-        AudioEnqueue(spdif, spdif_sz);
+        for (n = CodecAudioBurstSync(audio_decoder, spdif_sz); n > 0; --n) {
+            AudioEnqueue(spdif, spdif_sz);
+        }
 
         audio_decoder->SpdifIndex = 0;
         audio_decoder->SpdifCount = 0;
@@ -1492,105 +1779,125 @@ void CodecAudioDecode(AudioDecoder * audio_decoder, const AVPacket * avpkt)
 /**
 **  Set/update audio pts clock.
 **
+**  The drift of the audio clock against the monotonic clock is taken
+**  from the filtered audio clock, an integral controller turns it into
+**  the resample compensation.  With video master sync the audio/video
+**  difference reported by the video output drives a PI controller
+**  instead, audio follows the display clock.
+**
 **  @param audio_decoder    audio decoder data
 **  @param pts              presentation timestamp
 */
 static void CodecAudioSetClock(AudioDecoder * audio_decoder, int64_t pts)
 {
 #ifdef USE_AUDIO_DRIFT_CORRECTION
-    struct timespec nowtime;
-    int64_t delay;
-    int64_t tim_diff;
     int64_t pts_diff;
     int drift;
     int corr;
+    int diff;
+    int max;
+    int sync;
 
     AudioSetClock(pts);
 
-    delay = AudioGetDelay();
-    if (!delay) {
-        return;
-    }
-    clock_gettime(CLOCK_MONOTONIC, &nowtime);
     if (!audio_decoder->LastDelay) {
-        audio_decoder->LastTime = nowtime;
         audio_decoder->LastPTS = pts;
-        audio_decoder->LastDelay = delay;
+        audio_decoder->LastDelay = 1;
         audio_decoder->Drift = 0;
         audio_decoder->DriftFrac = 0;
-        Debug(3, "codec/audio: inital drift delay %" PRId64 "ms\n", delay / 90);
+        audio_decoder->DriftRest = 0;
+        audio_decoder->SyncCorr = 0;
         return;
     }
-    // collect over some time
+    // correct once a second
     pts_diff = pts - audio_decoder->LastPTS;
-    if (pts_diff < 10 * 1000 * 90) {
+    if (pts_diff < 1000 * 90) {
+        if (pts_diff < 0) {             // pts changed
+            audio_decoder->LastDelay = 0;
+        }
         return;
     }
-
-    tim_diff = (nowtime.tv_sec - audio_decoder->LastTime.tv_sec)
-        * 1000 * 1000 * 1000 + (nowtime.tv_nsec - audio_decoder->LastTime.tv_nsec);
-
-    drift = (tim_diff * 90) / (1000 * 1000) - pts_diff + delay - audio_decoder->LastDelay;
-
-    // adjust rounding error
-    nowtime.tv_nsec -= nowtime.tv_nsec % (1000 * 1000 / 90);
-    audio_decoder->LastTime = nowtime;
     audio_decoder->LastPTS = pts;
-    audio_decoder->LastDelay = delay;
-
-    if (0) {
-        Debug(3, "codec/audio: interval P:%5" PRId64 "ms T:%5" PRId64 "ms D:%4" PRId64 "ms %f %d\n", pts_diff / 90,
-            tim_diff / (1000 * 1000), delay / 90, drift / 90.0, audio_decoder->DriftCorr);
-    }
-    // underruns and av_resample have the same time :(((
-    if (abs(drift) > 10 * 90) {
-        // drift too big, pts changed?
-        Debug(3, "codec/audio: drift(%6d) %3dms reset\n", audio_decoder->DriftCorr, drift / 90);
-        audio_decoder->LastDelay = 0;
-#ifdef DEBUG
-        corr = 0;                       // keep gcc happy
-#endif
-    } else {
-
-        drift += audio_decoder->Drift;
-        audio_decoder->Drift = drift;
-        corr = (10 * audio_decoder->HwSampleRate * drift) / (90 * 1000);
-        // SPDIF/HDMI passthrough
-        if ((CodecAudioDrift & CORRECT_AC3) && (!(CodecPassthrough & CodecAC3)
-                || audio_decoder->AudioCtx->codec_id != AV_CODEC_ID_AC3)
-            && (!(CodecPassthrough & CodecEAC3)
-                || audio_decoder->AudioCtx->codec_id != AV_CODEC_ID_EAC3)) {
-            audio_decoder->DriftCorr = -corr;
+    sync = 0;
+    // limit correction to 0.5%, pitch change isn't noticed
+    // compensation is in samples over 10 seconds
+    max = audio_decoder->HwSampleRate / 20;
+
+    // video master: the video - audio difference drives the correction
+    if (VideoGetMasterSyncDiff(&diff)) {
+        if ((CodecPassthrough & CodecAC3 && audio_decoder->AudioCtx->codec_id == AV_CODEC_ID_AC3)
+            || (CodecPassthrough & CodecEAC3 && audio_decoder->AudioCtx->codec_id == AV_CODEC_ID_EAC3)) {
+            return;                     // bursts are dropped or repeated
         }
-
-        if (audio_decoder->DriftCorr < -20000) {    // limit correction
-            audio_decoder->DriftCorr = -20000;
-        } else if (audio_decoder->DriftCorr > 20000) {
-            audio_decoder->DriftCorr = 20000;
+        // audio late: negative correction shortens the samples
+        // proportional part corrects the difference in 4s, integral in 40s
+        corr = -((int64_t) diff * 10 * audio_decoder->HwSampleRate) / (4 * 90000);
+        audio_decoder->SyncCorr += (corr * pts_diff) / (10 * 90000);
+        if (audio_decoder->SyncCorr < -max) {
+            audio_decoder->SyncCorr = -max;
+        } else if (audio_decoder->SyncCorr > max) {
+            audio_decoder->SyncCorr = max;
         }
+        corr += audio_decoder->SyncCorr;
+        if (corr < -max) {
+            corr = -max;
+        } else if (corr > max) {
+            corr = max;
+        }
+        audio_decoder->DriftCorr = corr;
+        audio_decoder->SyncMaster = 1;
+        drift = diff / 90;
+        sync = 1;
+        goto compensate;
+    }
+    if (audio_decoder->SyncMaster) {    // left video master sync
+        audio_decoder->SyncMaster = 0;
+        audio_decoder->SyncCorr = 0;
+        audio_decoder->DriftCorr = 0;
+        drift = 0;
+        corr = 0;
+        sync = 1;
+        goto compensate;
+    }
+    // audio clock drift in ppm, 0 while the audio clock isn't locked
+    if (!(drift = AudioGetClockDrift())) {
+        return;
+    }
+    // audio plays too fast: positive correction stretches the samples
+    // drift correction value is 10 * samples per second, gain 0.03 per
+    // second, the remainder is kept, small drifts are corrected too
+    audio_decoder->DriftRest += (int64_t) drift * 10 * audio_decoder->HwSampleRate * 3 * pts_diff;
+    corr = audio_decoder->DriftRest / (INT64_C(1000) * 1000 * 100 * 90000);
+    audio_decoder->DriftRest -= corr * (INT64_C(1000) * 1000 * 100 * 90000);
+    audio_decoder->Drift = drift;
+    // SPDIF/HDMI passthrough
+    if ((CodecAudioDrift & CORRECT_AC3) && (!(CodecPassthrough & CodecAC3)
+            || audio_decoder->AudioCtx->codec_id != AV_CODEC_ID_AC3)
+        && (!(CodecPassthrough & CodecEAC3)
+            || audio_decoder->AudioCtx->codec_id != AV_CODEC_ID_EAC3)) {
+        audio_decoder->DriftCorr += corr;
     }
 
-#ifdef USE_SWRESAMPLE
-    if (audio_decoder->Resample && audio_decoder->DriftCorr) {
-        int distance;
+    if (audio_decoder->DriftCorr < -max) {  // limit correction
+        audio_decoder->DriftCorr = -max;
+    } else if (audio_decoder->DriftCorr > max) {
+        audio_decoder->DriftCorr = max;
+    }
 
-        // try workaround for buggy ffmpeg 0.10
-        if (abs(audio_decoder->DriftCorr) < 2000) {
-            distance = (pts_diff * audio_decoder->HwSampleRate) / (900 * 1000);
-        } else {
-            distance = (pts_diff * audio_decoder->HwSampleRate) / (90 * 1000);
-        }
-        if (swr_set_compensation(audio_decoder->Resample, audio_decoder->DriftCorr / 10, distance)) {
+  compensate:
+#ifdef USE_SWRESAMPLE
+    if (audio_decoder->Resample && (audio_decoder->DriftCorr || sync)) {
+        // DriftCorr samples over 10 seconds
+        if (swr_set_compensation(audio_decoder->Resample, audio_decoder->DriftCorr,
+                10 * audio_decoder->HwSampleRate)) {
             Debug(3, "codec/audio: swr_set_compensation failed\n");
         }
     }
 #endif
 #ifdef USE_AVRESAMPLE
-    if (audio_decoder->Resample && audio_decoder->DriftCorr) {
-        int distance;
-
-        distance = (pts_diff * audio_decoder->HwSampleRate) / (900 * 1000);
-        if (avresample_set_compensation(audio_decoder->Resample, audio_decoder->DriftCorr / 10, distance)) {
+    if (audio_decoder->Resample && (audio_decoder->DriftCorr || sync)) {
+        if (avresample_set_compensation(audio_decoder->Resample, audio_decoder->DriftCorr,
+                10 * audio_decoder->HwSampleRate)) {
             Debug(3, "codec/audio: swr_set_compensation failed\n");
         }
     }
@@ -1599,7 +1906,8 @@ static void CodecAudioSetClock(AudioDecoder * audio_decoder, int64_t pts)
         static int c;
 
         if (!(c++ % 10)) {
-            Debug(3, "codec/audio: drift(%6d) %8dus %5d\n", audio_decoder->DriftCorr, drift * 1000 / 90, corr);
+            Debug(3, "codec/audio: drift(%6d) %5d%s %5d\n", audio_decoder->DriftCorr, drift, sync ? "ms" : "ppm",
+                corr);
         }
     }
 #else
@@ -1616,6 +1924,8 @@ static void CodecAudioUpdateFormat(AudioDecoder * audio_decoder)
 {
     int passthrough;
     const AVCodecContext *audio_ctx;
+    const int *map;
+    int reorder;
 
     if (CodecAudioUpdateHelper(audio_decoder, &passthrough)) {
         // FIXME: handle swresample format conversions.
@@ -1635,12 +1945,30 @@ static void CodecAudioUpdateFormat(AudioDecoder * audio_decoder)
     }
 #endif
 
+    // reorder channels while interleaving, pcm pass-through keeps order
+    map = NULL;
+    if (!(audio_decoder->Passthrough & CodecPCM) && audio_ctx->channels == audio_decoder->HwChannels) {
+        map = CodecAudioChannelMap(audio_decoder->HwChannels);
+    }
+    audio_decoder->Reordered = 0;
+    // float pipeline of the audio output, int16 if only the fallback can reorder
+    audio_decoder->Float = AudioUseFloat();
+    reorder = !(audio_decoder->Passthrough & CodecPCM) && CodecAudioChannelMap(audio_decoder->HwChannels);
+
 #ifdef USE_SWRESAMPLE
     audio_decoder->Resample =
-        swr_alloc_set_opts(audio_decoder->Resample, audio_ctx->channel_layout, AV_SAMPLE_FMT_S16,
-        audio_decoder->HwSampleRate, audio_ctx->channel_layout, audio_ctx->sample_fmt, audio_ctx->sample_rate, 0,
-        NULL);
+        swr_alloc_set_opts(audio_decoder->Resample, audio_ctx->channel_layout,
+        audio_decoder->Float ? AV_SAMPLE_FMT_FLT : AV_SAMPLE_FMT_S16, audio_decoder->HwSampleRate,
+        audio_ctx->channel_layout, audio_ctx->sample_fmt, audio_ctx->sample_rate, 0, NULL);
     if (audio_decoder->Resample) {
+        audio_decoder->Reordered = map && !swr_set_channel_mapping(audio_decoder->Resample, map);
+        if (!audio_decoder->Reordered) {
+            swr_set_channel_mapping(audio_decoder->Resample, NULL);
+            if (reorder && audio_decoder->Float) {
+                audio_decoder->Float = 0;
+                av_opt_set_sample_fmt(audio_decoder->Resample, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
+            }
+        }
         swr_init(audio_decoder->Resample);
     } else {
         Error(_("codec/audio: can't setup resample\n"));
@@ -1656,8 +1984,14 @@ static void CodecAudioUpdateFormat(AudioDecoder * audio_decoder)
     av_opt_set_int(audio_decoder->Resample, "in_sample_fmt", audio_ctx->sample_fmt, 0);
     av_opt_set_int(audio_decoder->Resample, "in_sample_rate", audio_ctx->sample_rate, 0);
     av_opt_set_int(audio_decoder->Resample, "out_channel_layout", audio_ctx->channel_layout, 0);
-    av_opt_set_int(audio_decoder->Resample, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
+    av_opt_set_int(audio_decoder->Resample, "out_sample_fmt",
+        audio_decoder->Float ? AV_SAMPLE_FMT_FLT : AV_SAMPLE_FMT_S16, 0);
     av_opt_set_int(audio_decoder->Resample, "out_sample_rate", audio_decoder->HwSampleRate, 0);
+    audio_decoder->Reordered = map && !avresample_set_channel_mapping(audio_decoder->Resample, map);
+    if (reorder && !audio_decoder->Reordered && audio_decoder->Float) {
+        audio_decoder->Float = 0;
+        av_opt_set_int(audio_decoder->Resample, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
+    }
 
     if (avresample_open(audio_decoder->Resample)) {
         avresample_free(&audio_decoder->Resample);
@@ -1718,19 +2052,44 @@ void CodecAudioDecode(AudioDecoder * audio_decoder, const AVPacket * avpkt)
                 return;
             }
             if (audio_decoder->Resample) {
-                uint8_t outbuf[8192 * 2 * 8];
+                uint8_t outbuf[8192 * 4 * 8];
                 uint8_t *out[1];
+                int frame_size;
 
+#ifdef DEBUG
+                struct timespec start;
+                struct timespec end;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+#endif
                 out[0] = outbuf;
+                frame_size = (audio_decoder->Float ? 4 : 2) * audio_decoder->HwChannels;
                 ret =
-                    swr_convert(audio_decoder->Resample, out, sizeof(outbuf) / (2 * audio_decoder->HwChannels),
+                    swr_convert(audio_decoder->Resample, out, sizeof(outbuf) / frame_size,
                     (const uint8_t **)frame->extended_data, frame->nb_samples);
                 if (ret > 0) {
-                    if (!(audio_decoder->Passthrough & CodecPCM)) {
-                        CodecReorderAudioFrame((int16_t *) outbuf, ret * 2 * audio_decoder->HwChannels,
-                            audio_decoder->HwChannels);
+                    if (!(audio_decoder->Passthrough & CodecPCM) && !audio_decoder->Reordered) {
+                        CodecReorderAudioFrame((int16_t *) outbuf, ret * frame_size, audio_decoder->HwChannels);
+                    }
+#ifdef DEBUG
+                    // conversion speed, compare with and without reorder by resampler
+                    clock_gettime(CLOCK_MONOTONIC, &end);
+                    audio_decoder->ConvertTime +=
+                        (end.tv_sec - start.tv_sec) * 1000000000LL + end.tv_nsec - start.tv_nsec;
+                    audio_decoder->ConvertSamples += ret * audio_decoder->HwChannels;
+                    if (audio_decoder->ConvertSamples > 10 * 48000 * 8 && audio_decoder->ConvertTime) {
+                        Debug(3, "codec/audio: convert%s %d channels %" PRIu64 " samples/s\n",
+                            audio_decoder->Reordered ? " + reorder" : "", audio_decoder->HwChannels,
+                            audio_decoder->ConvertSamples * 1000000000ULL / audio_decoder->ConvertTime);
+                        audio_decoder->ConvertTime = 0;
+                        audio_decoder->ConvertSamples = 0;
+                    }
+#endif
+                    if (audio_decoder->Float) {
+                        AudioEnqueueFloat((float *)outbuf, ret * frame_size);
+                    } else {
+                        AudioEnqueue(outbuf, ret * frame_size);
                     }
-                    AudioEnqueue(outbuf, ret * 2 * audio_decoder->HwChannels);
                 }
                 return;
             }
@@ -1786,3 +2145,139 @@ void CodecExit(void)
 {
     pthread_mutex_destroy(&CodecLockMutex);
 }
+
+#if defined(CODEC_AUDIO_TEST) && defined(USE_SWRESAMPLE)
+
+//----------------------------------------------------------------------------
+//  Test + Benchmark
+//----------------------------------------------------------------------------
+
+#include <time.h>
+
+int SysLogLevel;                        ///< show only errors
+
+/**
+**  Get monotonic time in seconds.
+*/
+static double CodecTestTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+**  Convert planar float decoder output to interleaved alsa order.
+**
+**  Without channel map the resampler interleaves in ffmpeg order and
+**  CodecReorderAudioFrame swaps the channels in a second pass, like
+**  the audio decoder did before.  With channel map the resampler does
+**  both in one pass.
+**
+**  @param in       planar float input, one plane per channel
+**  @param channels number of channels
+**  @param samples  number of samples per channel and call
+**  @param loops    number of calls
+**  @param map      resampler channel map or NULL
+**  @param out      interleaved s16 output of last call
+**
+**  @returns throughput in samples per second.
+*/
+static double CodecTestConvert(float *const *in, int channels, int samples, int loops, const int *map, int16_t * out)
+{
+    SwrContext *swr;
+    int64_t layout;
+    double start;
+    int l;
+    int n;
+
+    layout = av_get_default_channel_layout(channels);
+    swr = swr_alloc_set_opts(NULL, layout, AV_SAMPLE_FMT_S16, 48000, layout, AV_SAMPLE_FMT_FLTP, 48000, 0, NULL);
+    if (!swr || (map && swr_set_channel_mapping(swr, map) < 0) || swr_init(swr) < 0) {
+        fprintf(stderr, "%d channels: can't setup resampler\n", channels);
+        exit(-1);
+    }
+
+    n = 0;
+    start = CodecTestTime();
+    for (l = 0; l < loops; ++l) {
+        uint8_t *o[1] = { (uint8_t *) out };
+
+        n = swr_convert(swr, o, samples, (const uint8_t **)in, samples);
+        if (n < 0) {
+            fprintf(stderr, "%d channels: can't convert audio\n", channels);
+            exit(-1);
+        }
+        if (!map) {
+            CodecReorderAudioFrame(out, n * 2 * channels, channels);
+        }
+    }
+    start = CodecTestTime() - start;
+    swr_free(&swr);
+
+    return (double)n *loops / start;
+}
+
+/**
+**  Main entry point.
+**
+**  codec_audio_test [loops]
+**
+**  Converts random AC-3/E-AC-3 sized frames (1536 samples) for 5, 6
+**  and 8 channels with the reorder after the resampler and with the
+**  resampler channel map, checks that both give the same samples and
+**  prints the throughput of both in Msamples/s.
+*/
+int main(int argc, char *const argv[])
+{
+    static const int channels[] = { 5, 6, 8 };
+    const int samples = 1536;
+    float *in[8];
+    int16_t *reorder;
+    int16_t *mapped;
+    double old_rate;
+    double new_rate;
+    int loops;
+    int i;
+    int c;
+    int s;
+
+    loops = argc > 1 ? atoi(argv[1]) : 20000;
+    if (loops <= 0) {
+        fprintf(stderr, "usage: %s [loops]\n", argv[0]);
+        return -1;
+    }
+
+    srand(1);
+    for (c = 0; c < 8; ++c) {
+        in[c] = malloc(samples * sizeof(float));
+        for (s = 0; s < samples; ++s) {
+            in[c][s] = rand() / (RAND_MAX / 2.0f) - 1.0f;
+        }
+    }
+    reorder = malloc(samples * 8 * sizeof(*reorder));
+    mapped = malloc(samples * 8 * sizeof(*mapped));
+
+    for (i = 0; i < (int)(sizeof(channels) / sizeof(*channels)); ++i) {
+        c = channels[i];
+        old_rate = CodecTestConvert(in, c, samples, loops, NULL, reorder);
+        new_rate = CodecTestConvert(in, c, samples, loops, CodecAudioChannelMap(c), mapped);
+        if (memcmp(reorder, mapped, samples * c * sizeof(*mapped))) {
+            printf("%d channels: channel map and reorder differ\n", c);
+            return 1;
+        }
+        printf("%d channels: reorder %6.1f Msamples/s, channel map %6.1f Msamples/s (%+.1f%%)\n", c,
+            old_rate / 1e6, new_rate / 1e6, (new_rate / old_rate - 1.0) * 100.0);
+    }
+
+    for (c = 0; c < 8; ++c) {
+        free(in[c]);
+    }
+    free(reorder);
+    free(mapped);
+
+    return 0;
+}
+
+#endif
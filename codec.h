@@ -53,6 +53,23 @@ extern AVBufferRef *hw_device_ctx;
 ///
 /// Video decoder structure.
 ///
+#define CODEC_VIDEO_CACHE_MAX 3         ///< idle opened video decoder contexts
+
+///
+/// Idle opened video decoder context, kept for the next stream.
+///
+typedef struct _video_codec_cache_
+{
+    AVCodecContext *VideoCtx;           ///< flushed codec context, NULL unused
+    AVCodec *VideoCodec;                ///< codec of context
+    int Profile;                        ///< profile of last stream
+    int Width;                          ///< width of last stream
+    int Height;                         ///< height of last stream
+    enum AVPixelFormat PixFmt;          ///< software pixel format of last stream
+    int Filter;                         ///< flag deint filter was used
+    uint32_t LastUse;                   ///< use counter for LRU
+} VideoCodecCache;
+
 struct _video_decoder_
 {
     VideoHwDecoder *HwDecoder;          ///< video hardware decoder
@@ -67,6 +84,14 @@ struct _video_decoder_
 
     int filter;                         // flag for deint filter
 
+    uint8_t *Extradata;                 ///< extradata for next open
+    int ExtradataSize;                  ///< size of extradata
+
+    VideoCodecCache Cache[CODEC_VIDEO_CACHE_MAX];   ///< idle decoder contexts
+    uint32_t CacheUse;                  ///< use counter of cache
+    char CacheHit;                      ///< context reused, format to check
+    VideoCodecCache CacheKey;           ///< format of reused context
+
     /* hwaccel options */
     enum HWAccelID hwaccel_id;
     char *hwaccel_device;
@@ -117,6 +142,9 @@ extern AVBufferRef *HwDeviceContext;
 /// Flag prefer fast xhannel switch
 extern char CodecUsePossibleDefectFrames;
 
+/// Number of software video decoder threads
+extern int CodecVideoThreads;
+
 //----------------------------------------------------------------------------
 //  Prototypes
 //----------------------------------------------------------------------------
@@ -127,6 +155,9 @@ extern VideoDecoder *CodecVideoNewDecoder(VideoHwDecoder *);
 /// Deallocate a video decoder context.
 extern void CodecVideoDelDecoder(VideoDecoder *);
 
+/// Set extradata for next open of video codec.
+extern void CodecVideoSetExtradata(VideoDecoder *, const uint8_t *, int);
+
 /// Open video codec.
 extern void CodecVideoOpen(VideoDecoder *, int);
 
@@ -136,6 +167,9 @@ extern void CodecVideoClose(VideoDecoder *);
 /// Decode a video packet.
 extern void CodecVideoDecode(VideoDecoder *, const AVPacket *);
 
+/// Set pictures discarded by video decoder.
+extern void CodecVideoSetDiscard(VideoDecoder *, int);
+
 /// Flush video buffers.
 extern void CodecVideoFlushBuffers(VideoDecoder *);
 
@@ -99,6 +99,7 @@ static int ConfigOsdHeight;             ///< config OSD height
 static char ConfigVideoStudioLevels;    ///< config use studio levels
 static char ConfigVideo60HzMode;        ///< config use 60Hz display mode
 static char ConfigVideoSoftStartSync;   ///< config use softstart sync
+static char ConfigVideoMasterSync;      ///< config use video master sync
 static char ConfigVideoBlackPicture;    ///< config enable black picture mode
 char ConfigVideoClearOnSwitch;          ///< config enable Clear on channel switch
 
@@ -147,6 +148,7 @@ static char ConfigAudioPassthrough;     ///< config audio pass-through mask
 static char AudioPassthroughState;      ///< flag audio pass-through on/off
 static char ConfigAudioDownmix;         ///< config ffmpeg audio downmix
 static char ConfigAudioSoftvol;         ///< config use software volume
+static char ConfigAudioFloat;           ///< config use float audio pipeline
 static char ConfigAudioNormalize;       ///< config use normalize volume
 static int ConfigAudioMaxNormalize;     ///< config max normalize factor
 static char ConfigAudioCompression;     ///< config use volume compression
@@ -974,6 +976,7 @@ class cMenuSetupSoft:public cMenuSetupPage
     int StudioLevels;
     int _60HzMode;
     int SoftStartSync;
+    int MasterSync;
     int BlackPicture;
     int ClearOnSwitch;
 
@@ -1010,6 +1013,7 @@ class cMenuSetupSoft:public cMenuSetupPage
     int AudioPassthroughEAC3;
     int AudioDownmix;
     int AudioSoftvol;
+    int AudioFloat;
     int AudioNormalize;
     int AudioMaxNormalize;
     int AudioCompression;
@@ -1197,6 +1201,7 @@ void cMenuSetupSoft::Create(void)
 #endif
         Add(new cMenuEditBoolItem(tr("60hz display mode"), &_60HzMode, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Soft start a/v sync"), &SoftStartSync, trVDR("no"), trVDR("yes")));
+        Add(new cMenuEditBoolItem(tr("Video master a/v sync"), &MasterSync, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Black during channel switch"), &BlackPicture, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Clear decoder on channel switch"), &ClearOnSwitch, trVDR("no"), trVDR("yes")));
 
@@ -1268,6 +1273,7 @@ void cMenuSetupSoft::Create(void)
                 trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Enable (E-)AC-3 (decoder) downmix"), &AudioDownmix, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Volume control"), &AudioSoftvol, tr("Hardware"), tr("Software")));
+        Add(new cMenuEditBoolItem(tr("Float audio processing"), &AudioFloat, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Enable normalize volume"), &AudioNormalize, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditIntItem(tr("  Max normalize factor (/1000)"), &AudioMaxNormalize, 0, 10000));
         Add(new cMenuEditBoolItem(tr("Enable volume compression"), &AudioCompression, trVDR("no"), trVDR("yes")));
@@ -1403,6 +1409,7 @@ cMenuSetupSoft::cMenuSetupSoft(void)
     StudioLevels = ConfigVideoStudioLevels;
     _60HzMode = ConfigVideo60HzMode;
     SoftStartSync = ConfigVideoSoftStartSync;
+    MasterSync = ConfigVideoMasterSync;
     BlackPicture = ConfigVideoBlackPicture;
     ClearOnSwitch = ConfigVideoClearOnSwitch;
 
@@ -1447,6 +1454,7 @@ cMenuSetupSoft::cMenuSetupSoft(void)
     AudioPassthroughEAC3 = ConfigAudioPassthrough & CodecEAC3;
     AudioDownmix = ConfigAudioDownmix;
     AudioSoftvol = ConfigAudioSoftvol;
+    AudioFloat = ConfigAudioFloat;
     AudioNormalize = ConfigAudioNormalize;
     AudioMaxNormalize = ConfigAudioMaxNormalize;
     AudioCompression = ConfigAudioCompression;
@@ -1538,6 +1546,8 @@ void cMenuSetupSoft::Store(void)
     VideoSet60HzMode(ConfigVideo60HzMode);
     SetupStore("SoftStartSync", ConfigVideoSoftStartSync = SoftStartSync);
     VideoSetSoftStartSync(ConfigVideoSoftStartSync);
+    SetupStore("MasterSync", ConfigVideoMasterSync = MasterSync);
+    VideoSetMasterSync(ConfigVideoMasterSync);
     SetupStore("BlackPicture", ConfigVideoBlackPicture = BlackPicture);
     VideoSetBlackPicture(ConfigVideoBlackPicture);
     SetupStore("ClearOnSwitch", ConfigVideoClearOnSwitch = ClearOnSwitch);
@@ -1622,6 +1632,8 @@ void cMenuSetupSoft::Store(void)
     CodecSetAudioDownmix(ConfigAudioDownmix);
     SetupStore("AudioSoftvol", ConfigAudioSoftvol = AudioSoftvol);
     AudioSetSoftvol(ConfigAudioSoftvol);
+    SetupStore("AudioFloat", ConfigAudioFloat = AudioFloat);
+    AudioSetFloat(ConfigAudioFloat);
     SetupStore("AudioNormalize", ConfigAudioNormalize = AudioNormalize);
     SetupStore("AudioMaxNormalize", ConfigAudioMaxNormalize = AudioMaxNormalize);
     AudioSetNormalize(ConfigAudioNormalize, ConfigAudioMaxNormalize);
@@ -2153,6 +2165,23 @@ void cSoftHdMenu::Create(void)
     int dropped;
     int counter;
     float frametime;
+    int decoder_wakeups;
+    int decoder_latency;
+    int decoder_latency_max;
+    int trick_decoded;
+    int trick_skipped;
+    float trick_fps;
+    int discard_nonref;
+    int discard_bidir;
+    int audio_packets;
+    int audio_copies;
+    int audio_wakeups;
+    int audio_latency;
+    int audio_start;
+    int latency_p50;
+    int latency_p90;
+    int latency_p99;
+    int latency_max;
 
     current = Current();                // get current menu item index
     Clear();                            // clear the menu
@@ -2191,6 +2220,37 @@ void cSoftHdMenu::Create(void)
     Add(new cOsdItem(cString::sprintf(tr(" Frames missed(%d) duped(%d) dropped(%d) total(%d)"), missed, duped, dropped,
                 counter), osUnknown, false));
     Add(new cOsdItem(cString::sprintf(tr(" Frame Process time %2.2fms"), frametime), osUnknown, false));
+    VideoGetDecoderStats(&decoder_wakeups, &decoder_latency, &decoder_latency_max);
+    if (decoder_wakeups) {
+        Add(new cOsdItem(cString::sprintf(tr(" Video decoder wakeups %d/s start latency %dus avg %dus max"),
+                    decoder_wakeups, decoder_latency, decoder_latency_max), osUnknown, false));
+    }
+    GetTrickStats(&trick_decoded, &trick_skipped, &trick_fps);
+    if (trick_decoded || trick_skipped) {
+        Add(new cOsdItem(cString::sprintf(tr(" Trick speed decoded(%d) skipped(%d) %2.2f fps of content"),
+                    trick_decoded, trick_skipped, trick_fps), osUnknown, false));
+    }
+    GetDiscardStats(&discard_nonref, &discard_bidir);
+    if (discard_nonref || discard_bidir) {
+        Add(new cOsdItem(cString::sprintf(tr(" Overload discarded non-ref(%d) bidir(%d)"), discard_nonref,
+                    discard_bidir), osUnknown, false));
+    }
+    if (GetAudioLatencyStats(&latency_p50, &latency_p90, &latency_p99, &latency_max)) {
+        Add(new cOsdItem(cString::sprintf(tr(" Audio enqueue p50 %dus p90 %dus p99 %dus max %dus"), latency_p50,
+                    latency_p90, latency_p99, latency_max), osUnknown, false));
+    }
+    AudioGetStats(&audio_packets, &audio_copies, &audio_wakeups, &audio_latency, &audio_start);
+    if (audio_packets) {
+        Add(new cOsdItem(cString::sprintf(tr(" Audio packets(%d) copied(%d)"), audio_packets, audio_copies),
+                osUnknown, false));
+    }
+    if (audio_wakeups) {
+        Add(new cOsdItem(cString::sprintf(tr(" Audio thread wakeups(%d) max latency %dus"), audio_wakeups,
+                    audio_latency), osUnknown, false));
+    }
+    if (audio_start) {
+        Add(new cOsdItem(cString::sprintf(tr(" Audio start after zap %dms"), audio_start), osUnknown, false));
+    }
     SetCurrent(Get(current));           // restore selected menu entry
     Display();                          // display build menu
 }
@@ -2457,6 +2517,64 @@ eOSState cSoftHdMenu::ProcessKey(eKeys key)
     return state;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//  cStatus
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vdr/status.h>
+
+/**
+**  Status monitor, tells the video parser the current live channel.
+*/
+class cSoftHdStatus:public cStatus
+{
+  protected:
+    virtual void ChannelSwitch(const cDevice *, int, bool);
+    virtual void Replaying(const cControl *, const char *, const char *, bool);
+};
+
+static cSoftHdStatus *MyStatus;         ///< status monitor
+
+/**
+**  Called on channel switch.
+**
+**  @param device       device which switched the channel
+**  @param channel_nr   number of new channel, 0 before switching
+**  @param live_view    channel switch for live view
+*/
+void cSoftHdStatus::ChannelSwitch( __attribute__((unused)) const cDevice * device, int channel_nr, bool live_view)
+{
+    const cChannel *channel;
+
+    if (!live_view) {
+        return;
+    }
+    if (!channel_nr) {                  // switch started, old channel ends
+        ::SetVideoChannelId(NULL);
+        return;
+    }
+    LOCK_CHANNELS_READ;
+    channel = Channels->GetByNumber(channel_nr);
+    ::SetVideoChannelId(channel ? *channel->GetChannelID().ToString() : NULL);
+}
+
+/**
+**  Called on replay start and stop.
+**
+**  @param control  replay control
+**  @param name     name of the recording
+**  @param filename file name of the recording
+**  @param on       true replay started
+*/
+void cSoftHdStatus::Replaying( __attribute__((unused)) const cControl * control, __attribute__((unused))
+    const char *name, __attribute__((unused))
+    const char *filename, bool on)
+{
+    if (on) {                           // recordings have no channel
+        ::SetVideoChannelId(NULL);
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //  cDevice
 //////////////////////////////////////////////////////////////////////////////
@@ -2680,14 +2798,26 @@ int64_t cSoftHdDevice::GetSTC(void)
 **  Every single frame shall then be displayed the given number of
 **  times.
 **
+**  Fast forward/rewind and reverse play decode only the key pictures.
+**
 **  @param speed    trick speed
 **  @param forward  flag forward direction
 */
 void cSoftHdDevice::TrickSpeed(int speed, bool forward)
 {
+    cControl *control;
+    bool play;
+    bool play_forward;
+    int play_speed;
+    int keyframes;
+
     dsyslog("[softhddev]%s: %d %d\n", __FUNCTION__, speed, forward);
 
-    ::TrickSpeed(speed);
+    keyframes = !forward;
+    if ((control = cControl::Control()) && control->GetReplayMode(play, play_forward, play_speed)) {
+        keyframes |= play && play_speed != -1;  // fast forward/rewind
+    }
+    ::TrickSpeed(speed, keyframes);
 }
 
 /**
@@ -2917,6 +3047,7 @@ int cSoftHdDevice::PlayVideo(const uchar * data, int length)
 */
 int cSoftHdDevice::PlayTsVideo(const uchar * data, int length)
 {
+    return::PlayTsVideo(data, length);
 }
 
 #endif
@@ -3044,6 +3175,8 @@ cPluginSoftHdDevice::~cPluginSoftHdDevice(void)
 {
     // dsyslog("[softhddev]%s:\n", __FUNCTION__);
 
+    delete MyStatus;
+
     ::SoftHdDeviceExit();
 
     // keep ConfigX11Display ...
@@ -3121,6 +3254,7 @@ bool cPluginSoftHdDevice::Start(void)
     }
 
     csoft = new cSoftRemote;
+    MyStatus = new cSoftHdStatus;
 
     switch (::Start()) {
         case 1:
@@ -3296,6 +3430,10 @@ bool cPluginSoftHdDevice::SetupParse(const char *name, const char *value)
         VideoSetSoftStartSync(ConfigVideoSoftStartSync = atoi(value));
         return true;
     }
+    if (!strcasecmp(name, "MasterSync")) {
+        VideoSetMasterSync(ConfigVideoMasterSync = atoi(value));
+        return true;
+    }
     if (!strcasecmp(name, "BlackPicture")) {
         VideoSetBlackPicture(ConfigVideoBlackPicture = atoi(value));
         return true;
@@ -3455,6 +3593,10 @@ bool cPluginSoftHdDevice::SetupParse(const char *name, const char *value)
         AudioSetSoftvol(ConfigAudioSoftvol = atoi(value));
         return true;
     }
+    if (!strcasecmp(name, "AudioFloat")) {
+        AudioSetFloat(ConfigAudioFloat = atoi(value));
+        return true;
+    }
     if (!strcasecmp(name, "AudioNormalize")) {
         ConfigAudioNormalize = atoi(value);
         AudioSetNormalize(ConfigAudioNormalize, ConfigAudioMaxNormalize);
@@ -26,6 +26,9 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #ifdef __FreeBSD__
 #include <signal.h>
 #endif
@@ -49,6 +52,10 @@
 #define __USE_GNU
 #endif
 #include <pthread.h>
+#ifndef HAVE_PTHREAD_NAME
+/// only available with newer glibc
+#define pthread_setname_np(thread, name)
+#endif
 
 #include "iatomic.h"                    // portable atomic_t
 #include "misc.h"
@@ -57,6 +64,8 @@
 #include "audio.h"
 #include "video.h"
 #include "codec.h"
+#include "startcode.h"
+#include "ringbuffer.h"
 
 #ifdef DEBUG
 static int DumpH264(const uint8_t * data, int size);
@@ -74,6 +83,7 @@ static signed char ConfigStartSuspended;    ///< flag to start in suspend mode
 static char ConfigFullscreen;           ///< fullscreen modus
 static const char *X11ServerArguments;  ///< default command arguments
 static char ConfigStillDecoder;         ///< hw/sw decoder for still picture
+static int ConfigVideoPacketBuffer;     ///< video packet arena size in MiB
 
 static pthread_mutex_t SuspendLockMutex;    ///< suspend lock mutex
 
@@ -156,17 +166,10 @@ static inline int FastMpegCheck(const uint8_t * p)
 }
 
 ///
-/// Check for Mpeg audio.
+/// Get Mpeg audio frame size.
 ///
 /// 0xFFEx already checked.
 ///
-/// @param data incomplete PES packet
-/// @param size number of bytes
-///
-/// @retval <0  possible mpeg audio, but need more data
-/// @retval 0   no valid mpeg audio
-/// @retval >0  valid mpeg audio
-///
 /// From: http://www.mpgedit.org/mpgedit/mpeg_format/mpeghdr.htm
 ///
 /// AAAAAAAA AAABBCCD EEEEFFGH IIJJKLMM
@@ -185,7 +188,11 @@ static inline int FastMpegCheck(const uint8_t * p)
 /// Layer II & III:
 /// FrameLengthInBytes = 144 * BitRate / SampleRate + Padding
 ///
-static int MpegCheck(const uint8_t * data, int size)
+/// @param data mpeg audio frame header
+///
+/// @returns frame size, 0 if invalid
+///
+static int MpegFrameSize(const uint8_t * data)
 {
     int mpeg2;
     int mpeg25;
@@ -236,6 +243,28 @@ static int MpegCheck(const uint8_t * data, int size)
             layer, bit_rate, sample_rate, frame_size);
     }
 
+    return frame_size;
+}
+
+///
+/// Check for Mpeg audio.
+///
+/// 0xFFEx already checked.
+///
+/// @param data incomplete PES packet
+/// @param size number of bytes
+///
+/// @retval <0  possible mpeg audio, but need more data
+/// @retval 0   no valid mpeg audio
+/// @retval >0  valid mpeg audio
+///
+static int MpegCheck(const uint8_t * data, int size)
+{
+    int frame_size;
+
+    if (!(frame_size = MpegFrameSize(data))) {
+        return 0;
+    }
     if (frame_size + 4 > size) {
         return -frame_size - 4;
     }
@@ -263,6 +292,19 @@ static inline int FastLatmCheck(const uint8_t * p)
     return 1;
 }
 
+///
+/// Get AAC LATM audio frame size.
+///
+/// @param data AAC LATM frame header
+///
+/// @returns frame size
+///
+static inline int LatmFrameSize(const uint8_t * data)
+{
+    // 13 bit frame size without header
+    return ((data[1] & 0x1F) << 8) + data[2] + 3;
+}
+
 ///
 /// Check for AAC LATM audio.
 ///
@@ -279,9 +321,7 @@ static int LatmCheck(const uint8_t * data, int size)
 {
     int frame_size;
 
-    // 13 bit frame size without header
-    frame_size = ((data[1] & 0x1F) << 8) + data[2];
-    frame_size += 3;
+    frame_size = LatmFrameSize(data);
 
     if (frame_size + 2 > size) {
         return -frame_size - 2;
@@ -329,16 +369,13 @@ static inline int FastAc3Check(const uint8_t * p)
 }
 
 ///
-/// Check for (E-)AC-3 audio.
+/// Get (E-)AC-3 audio frame size.
 ///
 /// 0x0B77xxxxxx already checked.
 ///
-/// @param data incomplete PES packet
-/// @param size number of bytes
+/// @param data (E-)AC-3 frame header (6 bytes)
 ///
-/// @retval <0  possible AC-3 audio, but need more data
-/// @retval 0   no valid AC-3 audio
-/// @retval >0  valid AC-3 audio
+/// @returns frame size, 0 if invalid
 ///
 /// o AC-3 Header
 /// AAAAAAAA AAAAAAAA BBBBBBBB BBBBBBBB CCDDDDDD EEEEEFFF
@@ -360,14 +397,10 @@ static inline int FastAc3Check(const uint8_t * p)
 /// o e 2x  Framesize code
 /// o f 2x  Framesize code 2
 ///
-static int Ac3Check(const uint8_t * data, int size)
+static int Ac3FrameSize(const uint8_t * data)
 {
     int frame_size;
 
-    if (size < 5) {                     // need 5 bytes to see if AC-3/E-AC-3
-        return -5;
-    }
-
     if (data[5] > (10 << 3)) {          // E-AC-3
         if ((data[4] & 0xF0) == 0xF0) { // invalid fscod fscod2
             return 0;
@@ -391,6 +424,32 @@ static int Ac3Check(const uint8_t * data, int size)
         frame_size = Ac3FrameSizeTable[frmsizcod][fscod] * 2;
     }
 
+    return frame_size;
+}
+
+///
+/// Check for (E-)AC-3 audio.
+///
+/// 0x0B77xxxxxx already checked.
+///
+/// @param data incomplete PES packet
+/// @param size number of bytes
+///
+/// @retval <0  possible AC-3 audio, but need more data
+/// @retval 0   no valid AC-3 audio
+/// @retval >0  valid AC-3 audio
+///
+static int Ac3Check(const uint8_t * data, int size)
+{
+    int frame_size;
+
+    if (size < 5) {                     // need 5 bytes to see if AC-3/E-AC-3
+        return -5;
+    }
+    if (!(frame_size = Ac3FrameSize(data))) {
+        return 0;
+    }
+
     if (frame_size + 5 > size) {
         return -frame_size - 5;
     }
@@ -422,6 +481,18 @@ static inline int FastAdtsCheck(const uint8_t * p)
     return 1;
 }
 
+///
+/// Get ADTS audio frame size.
+///
+/// @param data ADTS frame header (6 bytes)
+///
+/// @returns frame size (13 bit frame length)
+///
+static inline int AdtsFrameSize(const uint8_t * data)
+{
+    return (data[3] & 0x03) << 11 | (data[4] & 0xFF) << 3 | (data[5] & 0xE0) >> 5;
+}
+
 ///
 /// Check for ADTS Audio Data Transport Stream.
 ///
@@ -453,9 +524,7 @@ static int AdtsCheck(const uint8_t * data, int size)
         return -6;
     }
 
-    frame_size = (data[3] & 0x03) << 11;
-    frame_size |= (data[4] & 0xFF) << 3;
-    frame_size |= (data[5] & 0xE0) >> 5;
+    frame_size = AdtsFrameSize(data);
 
     if (frame_size + 3 > size) {
         return -frame_size - 3;
@@ -468,6 +537,67 @@ static int AdtsCheck(const uint8_t * data, int size)
     return 0;
 }
 
+///
+/// Check for next frame of an already detected audio codec.
+///
+/// Only the frame sync of the known codec is checked and its frame
+/// length field is trusted.  The header of the following frame isn't
+/// needed.
+///
+/// @param codec_id detected audio codec id
+/// @param data incomplete PES packet
+/// @param size number of bytes
+///
+/// @retval <0  frame of codec, but need more data
+/// @retval 0   sync lost
+/// @retval >0  frame size
+///
+static int LockedFrameCheck(int codec_id, const uint8_t * data, int size)
+{
+    int frame_size;
+
+    frame_size = 0;
+    switch (codec_id) {
+        case AV_CODEC_ID_MP2:
+            if (FastMpegCheck(data)) {
+                frame_size = MpegFrameSize(data);
+            }
+            break;
+        case AV_CODEC_ID_AC3:
+        case AV_CODEC_ID_EAC3:
+            if (size < 6) {
+                return -6;
+            }
+            // AC-3 and E-AC-3 can't be mixed
+            if (FastAc3Check(data) && (data[5] > (10 << 3)) == (codec_id == AV_CODEC_ID_EAC3)) {
+                frame_size = Ac3FrameSize(data);
+            }
+            break;
+        case AV_CODEC_ID_AAC_LATM:
+            if (FastLatmCheck(data)) {
+                frame_size = LatmFrameSize(data);
+            }
+            break;
+        case AV_CODEC_ID_AAC:
+            if (size < 6) {
+                return -6;
+            }
+            if (FastAdtsCheck(data)) {
+                frame_size = AdtsFrameSize(data);
+                if (frame_size < 7) {   // smaller than header
+                    frame_size = 0;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    if (frame_size > size) {
+        return -frame_size;
+    }
+    return frame_size;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //  PES Demux
 //////////////////////////////////////////////////////////////////////////////
@@ -534,11 +664,19 @@ typedef struct _pes_demux_
     int Index;                          ///< buffer index
     int Skip;                           ///< buffer skip
     int Size;                           ///< size of payload buffer
+    char Mirrored;                      ///< payload buffer is double mapped
 
     uint8_t StartCode;                  ///< pes packet start code
 
     int64_t PTS;                        ///< presentation time stamp
     int64_t DTS;                        ///< decode time stamp
+
+    char Locked;                        ///< frame sync locked to codec
+    int Resyncs;                        ///< counter of lost frame syncs
+
+    uint64_t BytesCopied;               ///< payload bytes copied into buffer
+    uint64_t BytesMoved;                ///< bytes moved by buffer compaction
+    uint64_t BytesDecoded;              ///< bytes passed to the decoder
 } PesDemux;
 
 ///
@@ -552,6 +690,78 @@ static void PesReset(PesDemux * pesdx)
     pesdx->StartCode = -1;
     pesdx->PTS = AV_NOPTS_VALUE;
     pesdx->DTS = AV_NOPTS_VALUE;
+    pesdx->Locked = 0;
+}
+
+///
+/// Allocate a double mapped payload buffer.
+///
+/// The same memory is mapped twice back-to-back (plus one page for the
+/// decoder padding), so every frame in the ring can be accessed as one
+/// contiguous block, without moving the data to the buffer start.
+///
+/// @param size size of the buffer, must be a multiple of the page size
+///
+/// @returns buffer or NULL, if double mapping isn't supported.
+///
+static uint8_t *PesMirrorAlloc(int size)
+{
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    uint8_t *addr;
+    long page;
+    int fd;
+
+    page = sysconf(_SC_PAGESIZE);
+    if (page <= 0 || size % page || page < AV_INPUT_BUFFER_PADDING_SIZE) {
+        return NULL;
+    }
+    if ((fd = memfd_create("pesdemux", MFD_CLOEXEC)) < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, size)) {
+        close(fd);
+        return NULL;
+    }
+    // reserve address space, then map the buffer over it
+    addr = mmap(NULL, 2 * size + page, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if (mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+        || mmap(addr + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+        || mmap(addr + 2 * size, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(addr, 2 * size + page);
+        close(fd);
+        return NULL;
+    }
+    close(fd);                          // mappings keep the memory
+
+    return addr;
+#else
+    (void)size;
+    return NULL;
+#endif
+}
+
+///
+/// Cleanup a packetized elementary stream demuxer.
+///
+/// @param pesdx    packetized elementary stream demuxer
+///
+static void PesExit(PesDemux * pesdx)
+{
+    if (!pesdx->Buffer) {
+        return;
+    }
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    if (pesdx->Mirrored) {
+        munmap(pesdx->Buffer, 2 * pesdx->Size + sysconf(_SC_PAGESIZE));
+        pesdx->Buffer = NULL;
+        return;
+    }
+#endif
+    av_freep(&pesdx->Buffer);
 }
 
 ///
@@ -561,15 +771,46 @@ static void PesReset(PesDemux * pesdx)
 ///
 static void PesInit(PesDemux * pesdx)
 {
+    PesExit(pesdx);                     // start called again
     memset(pesdx, 0, sizeof(*pesdx));
     pesdx->Size = PES_MAX_PAYLOAD;
-    pesdx->Buffer = av_malloc(PES_MAX_PAYLOAD + AV_INPUT_BUFFER_PADDING_SIZE);
-    if (!pesdx->Buffer) {
-        Fatal(_("pesdemux: out of memory\n"));
+    if ((pesdx->Buffer = PesMirrorAlloc(PES_MAX_PAYLOAD))) {
+        pesdx->Mirrored = 1;
+    } else {
+        Debug(3, "pesdemux: double mapped buffer unsupported\n");
+        pesdx->Buffer = av_malloc(PES_MAX_PAYLOAD + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!pesdx->Buffer) {
+            Fatal(_("pesdemux: out of memory\n"));
+        }
     }
     PesReset(pesdx);
 }
 
+///
+/// Remove the already decoded bytes from the payload buffer.
+///
+/// A double mapped buffer is only rebased, the data isn't moved.
+///
+/// @param pesdx    packetized elementary stream demuxer
+///
+static void PesCompact(PesDemux * pesdx)
+{
+    if (pesdx->Mirrored) {
+        if (pesdx->Skip >= pesdx->Size) {
+            pesdx->Skip -= pesdx->Size;
+            pesdx->Index -= pesdx->Size;
+        }
+        return;
+    }
+    if (pesdx->Skip) {
+        // copy remaining bytes down
+        pesdx->Index -= pesdx->Skip;
+        memmove(pesdx->Buffer, pesdx->Buffer + pesdx->Skip, pesdx->Index);
+        pesdx->BytesMoved += pesdx->Index;
+        pesdx->Skip = 0;
+    }
+}
+
 ///
 /// Parse packetized elementary stream.
 ///
@@ -584,11 +825,8 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size, int is_st
     const uint8_t *q;
 
     if (is_start) {                     // start of pes packet
-        if (pesdx->Index && pesdx->Skip) {
-            // copy remaining bytes down
-            pesdx->Index -= pesdx->Skip;
-            memmove(pesdx->Buffer, pesdx->Buffer + pesdx->Skip, pesdx->Index);
-            pesdx->Skip = 0;
+        if (pesdx->Index) {
+            PesCompact(pesdx);
         }
         pesdx->State = PES_SYNC;
         pesdx->HeaderIndex = 0;
@@ -597,10 +835,7 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size, int is_st
     }
     // cleanup, if too much cruft
     if (pesdx->Skip > PES_MAX_PAYLOAD / 2) {
-        // copy remaining bytes down
-        pesdx->Index -= pesdx->Skip;
-        memmove(pesdx->Buffer, pesdx->Buffer + pesdx->Skip, pesdx->Index);
-        pesdx->Skip = 0;
+        PesCompact(pesdx);
     }
 
     p = data;
@@ -633,11 +868,15 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size, int is_st
                 // FIXME: increase if needed the buffer
 
                 // fill buffer
-                n = pesdx->Size - pesdx->Index;
+                if (pesdx->Mirrored) {
+                    PesCompact(pesdx);  // only rebase, keeps index in map
+                }
+                n = pesdx->Size - (pesdx->Mirrored ? pesdx->Index - pesdx->Skip : pesdx->Index);
                 if (n > size) {
                     n = size;
                 }
                 memcpy(pesdx->Buffer + pesdx->Index, p, n);
+                pesdx->BytesCopied += n;
                 pesdx->Index += n;
                 p += n;
                 size -= n;
@@ -654,8 +893,18 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size, int is_st
                     // 3 bytes 0x56Exxx AAC LATM audio
                     // 7/9 bytes 0xFFFxxxxxxxxxxx ADTS audio
                     // PCM audio can't be found
-                    // FIXME: simple+faster detection, if codec already known
                     r = 0;
+                    if (pesdx->Locked) {
+                        // codec already known, jump from frame to frame
+                        r = LockedFrameCheck(AudioCodecID, q, n);
+                        codec_id = AudioCodecID;
+                        if (!r) {
+                            ++pesdx->Resyncs;
+                            Debug(3, "pesdemux: sync lost @%d %02x, %d resyncs\n", pesdx->Skip, q[0],
+                                pesdx->Resyncs);
+                            pesdx->Locked = 0;
+                        }
+                    }
                     if (!r && FastMpegCheck(q)) {
                         r = MpegCheck(q, n);
                         codec_id = AV_CODEC_ID_MP2;
@@ -688,6 +937,8 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size, int is_st
                             CodecAudioOpen(MyAudioDecoder, codec_id);
                             AudioCodecID = codec_id;
                         }
+                        // frame and following frame verified, lock sync
+                        pesdx->Locked = 1;
                         av_init_packet(avpkt);
                         avpkt->data = (void *)q;
                         avpkt->size = r;
@@ -695,6 +946,7 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size, int is_st
                         avpkt->dts = pesdx->DTS;
                         // FIXME: not aligned for ffmpeg
                         CodecAudioDecode(MyAudioDecoder, avpkt);
+                        pesdx->BytesDecoded += r;
                         pesdx->PTS = AV_NOPTS_VALUE;
                         pesdx->DTS = AV_NOPTS_VALUE;
                         pesdx->Skip += r;
@@ -982,57 +1234,26 @@ static int TsDemuxer(TsDemux * tsdx, const uint8_t * data, int size)
 #endif
 
 /**
-**  Play audio packet.
+**  Decode audio PES packet, called by the audio decode thread.
 **
 **  @param data data of exactly one complete PES packet
 **  @param size size of PES packet
 **  @param id   PES packet type
 */
-int PlayAudio(const uint8_t * data, int size, uint8_t id)
+static void AudioDecodePes(const uint8_t * data, int size, uint8_t id)
 {
     int n;
     const uint8_t *p;
 
     // channel switch: SetAudioChannelDevice: SetDigitalAudioDevice:
 
-    if (SkipAudio || !MyAudioDecoder) { // skip audio
-        return size;
-    }
-    if (StreamFreezed) {                // stream freezed
-        return 0;
-    }
-    if (AudioDelay) {
-        Debug(3, "AudioDelay %dms\n", AudioDelay);
-        usleep(AudioDelay / 90);
-        AudioDelay = 0;
-        return 0;
-    }
-    if (NewAudioStream) {
-        // this clears the audio ringbuffer indirect, open and setup does it
-        CodecAudioClose(MyAudioDecoder);
-        AudioFlushBuffers();
-        AudioSetBufferTime(ConfigAudioBufferTime);
-        AudioCodecID = AV_CODEC_ID_NONE;
-        AudioChannelID = -1;
-        NewAudioStream = 0;
-    }
-    // hard limit buffer full: don't overrun audio buffers on replay
-    if (AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE) {
-        return 0;
-    }
-#ifdef USE_SOFTLIMIT
-    // soft limit buffer full
-    if (AudioSyncStream && VideoGetBuffers(AudioSyncStream) > 3 && AudioUsedBytes() > AUDIO_MIN_BUFFER_FREE * 2) {
-        return 0;
-    }
-#endif
     // PES header 0x00 0x00 0x01 ID
     // ID 0xBD 0xC0-0xCF
 
     // must be a PES start code
     if (size < 9 || !data || data[0] || data[1] || data[2] != 0x01) {
         Error(_("[softhddev] invalid PES audio packet\n"));
-        return size;
+        return;
     }
     n = data[8];                        // header size
 
@@ -1042,7 +1263,7 @@ int PlayAudio(const uint8_t * data, int size, uint8_t id)
         } else {
             Error(_("[softhddev] invalid audio packet %d bytes\n"), size);
         }
-        return size;
+        return;
     }
 
     if (data[7] & 0x80 && n >= 5) {
@@ -1075,7 +1296,7 @@ int PlayAudio(const uint8_t * data, int size, uint8_t id)
     if ((id & 0xF0) == 0xA0) {
         if (n < 7) {
             Error(_("[softhddev] invalid LPCM audio packet %d bytes\n"), size);
-            return size;
+            return;
         }
         if (AudioCodecID != AV_CODEC_ID_PCM_DVD) {
             static int samplerates[] = { 48000, 96000, 44100, 32000 };
@@ -1117,7 +1338,7 @@ int PlayAudio(const uint8_t * data, int size, uint8_t id)
         swab(p + 7, AudioAvPkt->data, n - 7);
         AudioEnqueue(AudioAvPkt->data, n - 7);
 
-        return size;
+        return;
     }
     // DVD track header
     if ((id & 0xF0) == 0x80 && (p[0] & 0xF0) == 0x80) {
@@ -1204,91 +1425,454 @@ int PlayAudio(const uint8_t * data, int size, uint8_t id)
         memmove(AudioAvPkt->data, p, n);
     }
     AudioAvPkt->stream_index = n;
-
-    return size;
 }
 
 #ifndef NO_TS_AUDIO
 
 /**
-**  Play transport stream audio packet.
-**
-**  VDR can have buffered data belonging to previous channel!
+**  Decode transport stream audio packets, called by the audio decode
+**  thread.
 **
-**  @param data data of exactly one complete TS packet
-**  @param size size of TS packet (always TS_PACKET_SIZE)
-**
-**  @returns number of bytes consumed;
+**  @param data data of complete TS packets
+**  @param size size of TS packets (multiple of TS_PACKET_SIZE)
 */
-int PlayTsAudio(const uint8_t * data, int size)
+static void AudioDecodeTs(const uint8_t * data, int size)
 {
     static TsDemux tsdx[1];
 
-    if (SkipAudio || !MyAudioDecoder) { // skip audio
-        return size;
-    }
-    if (StreamFreezed) {                // stream freezed
-        return 0;
-    }
+    TsDemuxer(tsdx, data, size);
+}
 
-    if (NewAudioStream) {
-        // this clears the audio ringbuffer indirect, open and setup does it
-        CodecAudioClose(MyAudioDecoder);
-        AudioFlushBuffers();
-        // max time between audio packets 200ms + 24ms hw buffer
-        AudioSetBufferTime(ConfigAudioBufferTime);
-        AudioCodecID = AV_CODEC_ID_NONE;
-        AudioChannelID = -1;
-        NewAudioStream = 0;
-        PesReset(PesDemuxAudio);
-    }
-    // hard limit buffer full: don't overrun audio buffers on replay
-    if (AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE) {
-        return 0;
-    }
-#ifdef USE_SOFTLIMIT
-    // soft limit buffer full
-    if (AudioSyncStream && VideoGetBuffers(AudioSyncStream) > 3 && AudioUsedBytes() > AUDIO_MIN_BUFFER_FREE * 2) {
-        return 0;
-    }
 #endif
-    if (AudioDelay) {
-        Debug(3, "AudioDelay %dms\n", AudioDelay);
-        usleep(AudioDelay * 1000);
-        AudioDelay = 0;
-        // TsDemuxer(tsdx, data, size);   // insert dummy audio
 
-    }
-    return TsDemuxer(tsdx, data, size);
-}
+//////////////////////////////////////////////////////////////////////////////
+//  Audio decode thread
+//////////////////////////////////////////////////////////////////////////////
 
-#endif
+#define AUDIO_QUEUE_SIZE (256 * 1024)   ///< compressed audio queue bytes
+#define AUDIO_QUEUE_PACKET_MAX (65536 + 6)  ///< biggest PES packet
+#define AUDIO_LATENCY_REPORT 30000      ///< ms between latency reports
 
 /**
-**  Set volume of audio device.
-**
-**  @param volume   VDR volume (0 .. 255)
+**  Compressed audio queue entry header, the packet data follows.
 */
-void SetVolumeDevice(int volume)
+typedef struct _audio_queue_entry_
 {
-    AudioSetVolume((volume * 1000) / 255);
-}
+    int Size;                           ///< bytes of packet data, 0 new stream
+    uint8_t Id;                         ///< PES packet type, 0 TS packets
+    uint64_t Time;                      ///< enqueue time in us
+} AudioQueueEntry;
 
 /**
-*** Resets channel ID (restarts audio).
-**/
-void ResetChannelId(void)
+**  Latency histogram, buckets are powers of two microseconds.
+*/
+typedef struct _audio_latency_
 {
-    AudioChannelID = -1;
-    Debug(3, "audio/demux: reset channel id\n");
-}
+    uint32_t Count[32];                 ///< samples per bucket
+    uint32_t Samples;                   ///< number of samples
+    uint32_t Max;                       ///< biggest sample in us
+} AudioLatency;
+
+static RingBuffer *AudioQueueRb;        ///< compressed audio queue
+static pthread_mutex_t AudioQueueMutex; ///< audio queue lock
+static pthread_cond_t AudioQueueCond;   ///< wakeup audio decode thread
+static pthread_mutex_t AudioDecodeMutex;    ///< decoder in use lock
+static volatile uint32_t AudioQueueGeneration;  ///< changed by queue clear
+static pthread_t AudioDecodeThread;     ///< audio decode thread
+static volatile char AudioDecodeRunning;    ///< audio decode thread runs
+
+static AudioLatency AudioEnqueueLatency[1]; ///< time spent in VDR calls
+static AudioLatency AudioQueueLatency[1];   ///< time until decode starts
 
-//////////////////////////////////////////////////////////////////////////////
-//  Video
+/**
+**  Monotonic time in microseconds.
+*/
+static uint64_t AudioQueueTime(void)
+{
+    struct timespec tspec;
+
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t) tspec.tv_sec * 1000000 + tspec.tv_nsec / 1000;
+}
+
+/**
+**  Add sample to latency histogram.
+**
+**  @param latency  latency histogram
+**  @param us       latency in microseconds
+*/
+static void AudioLatencyAdd(AudioLatency * latency, uint64_t us)
+{
+    int i;
+
+    if (us > UINT32_MAX) {
+        us = UINT32_MAX;
+    }
+    for (i = 0; i < 31 && (us >> (i + 1)); ++i) {
+    }
+    ++latency->Count[i];
+    ++latency->Samples;
+    if (us > latency->Max) {
+        latency->Max = us;
+    }
+}
+
+/**
+**  Get percentile of latency histogram.
+**
+**  @param latency  latency histogram
+**  @param percent  percentile to get
+**
+**  @returns upper bound of bucket containing the percentile in us.
+*/
+static uint32_t AudioLatencyPercentile(const AudioLatency * latency, int percent)
+{
+    uint32_t n;
+    uint32_t limit;
+    int i;
+
+    limit = ((uint64_t) latency->Samples * percent + 99) / 100;
+    n = 0;
+    for (i = 0; i < 31; ++i) {
+        n += latency->Count[i];
+        if (n >= limit) {
+            break;
+        }
+    }
+    return (2U << i) - 1 < latency->Max ? (2U << i) - 1 : latency->Max;
+}
+
+/**
+**  Log latency percentiles.
+**
+**  @param name     name of latency
+**  @param latency  latency histogram
+*/
+static void AudioLatencyReport(const char *name, const AudioLatency * latency)
+{
+    if (!latency->Samples) {
+        return;
+    }
+    Info(_("audio: %s latency p50 %uus p90 %uus p99 %uus max %uus, %u packets\n"), name,
+        AudioLatencyPercentile(latency, 50), AudioLatencyPercentile(latency, 90), AudioLatencyPercentile(latency,
+            99), latency->Max, latency->Samples);
+}
+
+/**
+**  Drop queued compressed audio packets.
+**
+**  Waits until the decode thread has finished the current packet, no
+**  audio of the dropped packets reaches the output after return.
+*/
+static void AudioQueueClear(void)
+{
+    if (!AudioQueueRb) {
+        return;
+    }
+    pthread_mutex_lock(&AudioDecodeMutex);
+    pthread_mutex_lock(&AudioQueueMutex);
+    RingBufferReset(AudioQueueRb);
+    ++AudioQueueGeneration;
+    pthread_mutex_unlock(&AudioQueueMutex);
+    pthread_mutex_unlock(&AudioDecodeMutex);
+}
+
+/**
+**  Queue compressed audio packet for the decode thread.
+**
+**  @param data packet data, NULL new stream marker
+**  @param size size of packet data
+**  @param id   PES packet type, 0 TS packets
+**
+**  @returns true if queued, false if the queue is full.
+*/
+static int AudioQueuePut(const uint8_t * data, int size, uint8_t id)
+{
+    AudioQueueEntry entry;
+
+    entry.Size = size;
+    entry.Id = id;
+    entry.Time = AudioQueueTime();
+
+    pthread_mutex_lock(&AudioQueueMutex);
+    if (RingBufferFreeBytes(AudioQueueRb) < sizeof(entry) + size) {
+        pthread_mutex_unlock(&AudioQueueMutex);
+        return 0;
+    }
+    RingBufferWrite(AudioQueueRb, &entry, sizeof(entry));
+    if (size) {
+        RingBufferWrite(AudioQueueRb, data, size);
+    }
+    pthread_cond_signal(&AudioQueueCond);
+    pthread_mutex_unlock(&AudioQueueMutex);
+
+    AudioLatencyAdd(AudioEnqueueLatency, AudioQueueTime() - entry.Time);
+    return 1;
+}
+
+/**
+**  Handle new stream marker, close codec and flush output.
+*/
+static void AudioNewStream(void)
+{
+    // this clears the audio ringbuffer indirect, open and setup does it
+    CodecAudioClose(MyAudioDecoder);
+    AudioFlushBuffers();
+    // max time between audio packets 200ms + 24ms hw buffer
+    AudioSetBufferTime(ConfigAudioBufferTime);
+    AudioCodecID = AV_CODEC_ID_NONE;
+    AudioChannelID = -1;
+    AudioAvPkt->stream_index = 0;
+#ifndef NO_TS_AUDIO
+    PesReset(PesDemuxAudio);
+#endif
+}
+
+/**
+**  Audio decode thread.
+**
+**  Decodes the queued packets, waits for room in the audio output, so
+**  slow decoders or sync delays don't stall VDR's device feeding.
+**
+**  @param dummy    unused thread argument
+*/
+static void *AudioDecodeHandlerThread( __attribute__((unused))
+    void *dummy)
+{
+    AudioQueueEntry entry;
+    uint8_t *buffer;
+    uint32_t generation;
+#ifdef DEBUG
+    uint32_t report;
+#endif
+
+    Debug(3, "audio: decode thread started\n");
+    buffer = av_malloc(AUDIO_QUEUE_PACKET_MAX + AV_INPUT_BUFFER_PADDING_SIZE);
+#ifdef DEBUG
+    report = GetMsTicks();
+#endif
+
+    while (AudioDecodeRunning) {
+        pthread_mutex_lock(&AudioQueueMutex);
+        while (AudioDecodeRunning && RingBufferUsedBytes(AudioQueueRb) < sizeof(entry)) {
+            pthread_cond_wait(&AudioQueueCond, &AudioQueueMutex);
+        }
+        if (!AudioDecodeRunning) {
+            pthread_mutex_unlock(&AudioQueueMutex);
+            break;
+        }
+        RingBufferRead(AudioQueueRb, &entry, sizeof(entry));
+        RingBufferRead(AudioQueueRb, buffer, entry.Size);
+        generation = AudioQueueGeneration;
+        pthread_mutex_unlock(&AudioQueueMutex);
+
+        AudioLatencyAdd(AudioQueueLatency, AudioQueueTime() - entry.Time);
+
+        // hard limit buffer full: don't overrun audio buffers on replay
+        while (AudioDecodeRunning && generation == AudioQueueGeneration && entry.Size
+            && (StreamFreezed || AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE
+#ifdef USE_SOFTLIMIT
+                // soft limit buffer full
+                || (AudioSyncStream && VideoGetBuffers(AudioSyncStream) > 3
+                    && AudioUsedBytes() > AUDIO_MIN_BUFFER_FREE * 2)
+#endif
+            )) {
+            usleep(5 * 1000);
+        }
+        if (AudioDelay) {
+            Debug(3, "AudioDelay %dms\n", AudioDelay);
+            usleep(AudioDelay * 1000);
+            AudioDelay = 0;
+        }
+
+        pthread_mutex_lock(&AudioDecodeMutex);
+        if (generation == AudioQueueGeneration && !SkipAudio && MyAudioDecoder) {
+            if (!entry.Size) {
+                AudioNewStream();
+#ifndef NO_TS_AUDIO
+            } else if (!entry.Id) {
+                AudioDecodeTs(buffer, entry.Size);
+#endif
+            } else {
+                AudioDecodePes(buffer, entry.Size, entry.Id);
+            }
+        }
+        pthread_mutex_unlock(&AudioDecodeMutex);
+
+#ifdef DEBUG
+        if (GetMsTicks() - report > AUDIO_LATENCY_REPORT) {
+            AudioLatencyReport("enqueue", AudioEnqueueLatency);
+            AudioLatencyReport("queue", AudioQueueLatency);
+            report = GetMsTicks();
+        }
+#endif
+    }
+
+    av_free(buffer);
+    Debug(3, "audio: decode thread stopped\n");
+    return NULL;
+}
+
+/**
+**  Start audio decode thread.
+*/
+static void AudioDecodeStart(void)
+{
+    AudioQueueRb = RingBufferNew(AUDIO_QUEUE_SIZE);
+    pthread_mutex_init(&AudioQueueMutex, NULL);
+    pthread_cond_init(&AudioQueueCond, NULL);
+    pthread_mutex_init(&AudioDecodeMutex, NULL);
+    AudioDecodeRunning = 1;
+    pthread_create(&AudioDecodeThread, NULL, AudioDecodeHandlerThread, NULL);
+    pthread_setname_np(AudioDecodeThread, "softhddev adec");
+}
+
+/**
+**  Stop audio decode thread.
+*/
+static void AudioDecodeStop(void)
+{
+    if (!AudioQueueRb) {
+        return;
+    }
+    pthread_mutex_lock(&AudioQueueMutex);
+    AudioDecodeRunning = 0;
+    pthread_cond_signal(&AudioQueueCond);
+    pthread_mutex_unlock(&AudioQueueMutex);
+    pthread_join(AudioDecodeThread, NULL);
+
+    AudioLatencyReport("enqueue", AudioEnqueueLatency);
+    AudioLatencyReport("queue", AudioQueueLatency);
+
+    pthread_mutex_destroy(&AudioDecodeMutex);
+    pthread_cond_destroy(&AudioQueueCond);
+    pthread_mutex_destroy(&AudioQueueMutex);
+    RingBufferDel(AudioQueueRb);
+    AudioQueueRb = NULL;
+}
+
+/**
+**  Play audio packet.
+**
+**  The packet is only copied into the audio queue, the audio decode
+**  thread decodes it.
+**
+**  @param data data of exactly one complete PES packet
+**  @param size size of PES packet
+**  @param id   PES packet type
+**
+**  @returns number of bytes consumed, 0 if the queue is full.
+*/
+int PlayAudio(const uint8_t * data, int size, uint8_t id)
+{
+    if (SkipAudio || !MyAudioDecoder) { // skip audio
+        return size;
+    }
+    if (StreamFreezed) {                // stream freezed
+        return 0;
+    }
+    if (size > AUDIO_QUEUE_PACKET_MAX || !id) {
+        Error(_("[softhddev] invalid audio packet %d bytes\n"), size);
+        return size;
+    }
+    if (NewAudioStream) {               // queued packets are from old stream
+        AudioQueueClear();
+        AudioQueuePut(NULL, 0, 0);
+        NewAudioStream = 0;
+    }
+    return AudioQueuePut(data, size, id) ? size : 0;
+}
+
+#ifndef NO_TS_AUDIO
+
+/**
+**  Play transport stream audio packet.
+**
+**  VDR can have buffered data belonging to previous channel!
+**  The packets are only copied into the audio queue, the audio decode
+**  thread demuxes and decodes them.
+**
+**  @param data data of exactly one complete TS packet
+**  @param size size of TS packet (always TS_PACKET_SIZE)
+**
+**  @returns number of bytes consumed;
+*/
+int PlayTsAudio(const uint8_t * data, int size)
+{
+    if (SkipAudio || !MyAudioDecoder) { // skip audio
+        return size;
+    }
+    if (StreamFreezed) {                // stream freezed
+        return 0;
+    }
+    if (NewAudioStream) {               // queued packets are from old stream
+        AudioQueueClear();
+        AudioQueuePut(NULL, 0, 0);
+        NewAudioStream = 0;
+    }
+    size -= size % TS_PACKET_SIZE;
+    if (size > AUDIO_QUEUE_PACKET_MAX) {
+        size = AUDIO_QUEUE_PACKET_MAX - AUDIO_QUEUE_PACKET_MAX % TS_PACKET_SIZE;
+    }
+    if (!size) {                        // no complete packet
+        return 0;
+    }
+    return AudioQueuePut(data, size, 0) ? size : 0;
+}
+
+#endif
+
+/**
+**  Set volume of audio device.
+**
+**  @param volume   VDR volume (0 .. 255)
+*/
+void SetVolumeDevice(int volume)
+{
+    AudioSetVolume((volume * 1000) / 255);
+}
+
+/**
+*** Resets channel ID (restarts audio).
+**/
+void ResetChannelId(void)
+{
+    AudioChannelID = -1;
+    Debug(3, "audio/demux: reset channel id\n");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Video
 //////////////////////////////////////////////////////////////////////////////
 
-#define VIDEO_BUFFER_SIZE (1024 * 1024) ///< video PES buffer default size  512 * 1024
 #define VIDEO_PACKET_MAX 256            ///< max number of video packets  192
+#define VIDEO_ARENA_DEFAULT 64          ///< default packet arena size in MiB
+#define VIDEO_ARENA_ALIGN 64            ///< alignment of packets in arena
+#define VIDEO_ARENA_RESERVE (512 * 1024)    ///< arena bytes kept free for input
+
+#define VIDEO_DISCARD_NONREF 1          ///< discard non-reference pictures
+#define VIDEO_DISCARD_BIDIR 2           ///< discard all bidirectional pictures
+#define VIDEO_DISCARD_LATE -35          ///< ms video late to raise discard level
+#define VIDEO_DISCARD_SYNCED -15        ///< ms video late to lower discard level
+#define VIDEO_DISCARD_MASTER_LATE -100  ///< ms late to raise, with video master sync
+#define VIDEO_DISCARD_MASTER_SYNCED -35 ///< ms late to lower, with video master sync
+#define VIDEO_DISCARD_HOLD 25           ///< pictures between level changes
+
+/**
+**  Video packet descriptor.  The packet data is stored in the arena.
+*/
+typedef struct _video_packet_
+{
+    int Offset;                         ///< offset of packet data in arena
+    int Size;                           ///< bytes of packet data
+    int64_t PTS;                        ///< presentation time stamp
+    int64_t DTS;                        ///< decode time stamp
+    enum AVCodecID CodecID;             ///< codec id of packet
+    volatile char Held;                 ///< data referenced by decoder
+    char Extradata;                     ///< parameter sets for codec open
+    char KeyFrame;                      ///< 1 key picture, -1 other picture, 0 none
+    char Discard;                       ///< lowest discard level dropping picture
+} VideoPacket;
 
 /**
 **  Video output stream device structure.   Parser, decoder, display.
@@ -1308,19 +1892,36 @@ struct __video_stream__
     volatile char Freezed;              ///< stream freezed
 
     volatile char TrickSpeed;           ///< current trick speed
+    volatile char TrickKeyFrames;       ///< trick speed decodes key pictures only
     volatile char Close;                ///< command close video stream
     volatile char ClearBuffers;         ///< command clear video buffers
     volatile char ClearClose;           ///< clear video buffers for close
 
     int InvalidPesCounter;              ///< counter of invalid PES packets
 
-    enum AVCodecID CodecIDRb[VIDEO_PACKET_MAX]; ///< codec ids in ring buffer
-    AVPacket PacketRb[VIDEO_PACKET_MAX];    ///< PES packet ring buffer
+    char PacketPicture;                 ///< current packet has a picture
+    char PesCut;                        ///< last packet finished at PES end
+    char NoPesCut;                      ///< pictures not aligned to PES
+    char PesAligned;                    ///< PES start checked as access unit
+
+    VideoPacket PacketRb[VIDEO_PACKET_MAX]; ///< packet descriptor ring buffer
+    uint8_t *Arena;                     ///< packet data ring buffer
+    int ArenaSize;                      ///< size of packet data ring buffer
     int StartCodeState;                 ///< last three bytes start code state
 
     int PacketWrite;                    ///< ring buffer write pointer
     int PacketRead;                     ///< ring buffer read pointer
+    int PacketFree;                     ///< oldest packet not yet released
     atomic_t PacketsFilled;             ///< how many of the ring buffer is used
+
+    int TrickDecoded;                   ///< trick speed pictures decoded
+    int TrickSkipped;                   ///< trick speed pictures skipped
+    int64_t TrickFirstPTS;              ///< first decoded trick speed pts
+    int64_t TrickLastPTS;               ///< last decoded trick speed pts
+
+    int DiscardLevel;                   ///< overload discard level
+    int DiscardHold;                    ///< pictures until next level change
+    int Discarded[2];                   ///< pictures discarded per level
 };
 
 static VideoStream MyVideoStream[1];    ///< normal video stream
@@ -1329,8 +1930,8 @@ static VideoStream MyVideoStream[1];    ///< normal video stream
 static VideoStream PipVideoStream[1];   ///< pip video stream
 #endif
 
+uint32_t VideoSwitch;                   ///< video switch ticks
 #ifdef DEBUG
-uint32_t VideoSwitch;                   ///< debug video switch ticks
 static int VideoMaxPacketSize;          ///< biggest used packet buffer
 #endif
 // #define STILL_DEBUG 2
@@ -1346,24 +1947,26 @@ static volatile char Usr1Signal;        ///< true got usr1 signal
 /**
 **  Initialize video packet ringbuffer.
 **
+**  All packet data is stored in one arena, the descriptor ring only
+**  holds the offset, size and time stamps of the packets.
+**
 **  @param stream   video stream
 */
 static void VideoPacketInit(VideoStream * stream)
 {
-    int i;
-
-    for (i = 0; i < VIDEO_PACKET_MAX; ++i) {
-        AVPacket *avpkt;
+    int mib;
 
-        avpkt = &stream->PacketRb[i];
-        // build a clean ffmpeg av packet
-        if (av_new_packet(avpkt, VIDEO_BUFFER_SIZE)) {
-            Fatal(_("[softhddev] out of memory\n"));
-        }
+    mib = ConfigVideoPacketBuffer > 0 ? ConfigVideoPacketBuffer : VIDEO_ARENA_DEFAULT;
+    stream->ArenaSize = mib * 1024 * 1024;
+    // pages are only committed, when the ring reaches them
+    if (!(stream->Arena = av_malloc(stream->ArenaSize + AV_INPUT_BUFFER_PADDING_SIZE))) {
+        Fatal(_("[softhddev] out of memory\n"));
     }
+    Debug(3, "video: %d MiB packet arena\n", mib);
 
+    memset(stream->PacketRb, 0, sizeof(stream->PacketRb));
     atomic_set(&stream->PacketsFilled, 0);
-    stream->PacketRead = stream->PacketWrite = 0;
+    stream->PacketRead = stream->PacketWrite = stream->PacketFree = 0;
 }
 
 /**
@@ -1372,13 +1975,309 @@ static void VideoPacketInit(VideoStream * stream)
 **  @param stream   video stream
 */
 static void VideoPacketExit(VideoStream * stream)
+{
+    atomic_set(&stream->PacketsFilled, 0);
+
+    av_freep(&stream->Arena);
+    stream->ArenaSize = 0;
+}
+
+/**
+**  Release packet data of the decoder.
+**
+**  Called by ffmpeg, when the last reference of the packet is gone.
+**
+**  @param opaque   video packet descriptor
+**  @param data     packet data in arena
+*/
+static void VideoPacketRelease(void *opaque, __attribute__ ((unused)) uint8_t * data)
+{
+    ((VideoPacket *) opaque)->Held = 0;
+}
+
+/**
+**  Reclaim descriptors and arena space of decoded packets.
+**
+**  Packets still referenced by the decoder are kept, the space is
+**  released in ring order.  Must only be called by the stream feeder.
+**
+**  @param stream   video stream
+*/
+static void VideoArenaReclaim(VideoStream * stream)
+{
+    int read;
+
+    read = (stream->PacketWrite + VIDEO_PACKET_MAX - atomic_read(&stream->PacketsFilled)) % VIDEO_PACKET_MAX;
+    while (stream->PacketFree != read && !stream->PacketRb[stream->PacketFree].Held) {
+        stream->PacketFree = (stream->PacketFree + 1) % VIDEO_PACKET_MAX;
+    }
+}
+
+/**
+**  Get arena offset of the oldest packet not yet released by the decoder.
+**
+**  Empty packets (stream change markers) don't occupy arena space and
+**  are skipped.
+**
+**  @param stream   video stream
+**
+**  @returns offset of oldest packet, -1 if no packet with data is pending.
+*/
+static int VideoArenaStart(const VideoStream * stream)
 {
     int i;
 
-    atomic_set(&stream->PacketsFilled, 0);
+    for (i = stream->PacketFree; i != stream->PacketWrite; i = (i + 1) % VIDEO_PACKET_MAX) {
+        if (stream->PacketRb[i].Size) {
+            return stream->PacketRb[i].Offset;
+        }
+    }
+    return -1;
+}
+
+/**
+**  Get how many bytes can be appended to the current packet.
+**
+**  @param stream   video stream
+*/
+static int VideoArenaFree(const VideoStream * stream)
+{
+    const VideoPacket *pkt;
+    int start;
+    int n;
+
+    pkt = &stream->PacketRb[stream->PacketWrite];
+    start = VideoArenaStart(stream);
+    if (start == pkt->Offset) {         // wrapped onto the oldest packet
+        return 0;
+    }
+    if (start < 0 || start < pkt->Offset) {
+        // free to end of arena, or in front after moving the packet
+        n = stream->ArenaSize - pkt->Offset;
+        if (start < 0) {
+            start = stream->ArenaSize;
+        }
+        if (start - 1 > n) {
+            n = start - 1;
+        }
+    } else {                            // wrapped, free up to oldest packet
+        n = start - 1 - pkt->Offset;
+    }
+    n -= pkt->Size + AV_INPUT_BUFFER_PADDING_SIZE;
+
+    return n < 0 ? 0 : n;
+}
+
+/**
+**  Reserve space for more data of the current packet.
+**
+**  If the packet doesn't fit at the end of the arena, it is moved to the
+**  start of the arena.  Padding behind the packet is always reserved.
+**
+**  @param stream   video stream
+**  @param size     number of bytes to append
+**
+**  @returns pointer to append the data, NULL if the arena is full.
+*/
+static uint8_t *VideoArenaReserve(VideoStream * stream, int size)
+{
+    VideoPacket *pkt;
+    int start;
+    int need;
+
+    VideoArenaReclaim(stream);
+    pkt = &stream->PacketRb[stream->PacketWrite];
+    start = VideoArenaStart(stream);
+    need = pkt->Size + size + AV_INPUT_BUFFER_PADDING_SIZE;
 
-    for (i = 0; i < VIDEO_PACKET_MAX; ++i) {
-        av_packet_unref(&stream->PacketRb[i]);
+    if (start == pkt->Offset) {         // wrapped onto the oldest packet
+        return NULL;
+    }
+    if (start < 0 || start < pkt->Offset) {
+        if (pkt->Offset + need <= stream->ArenaSize) {
+            return stream->Arena + pkt->Offset + pkt->Size;
+        }
+        // must keep one byte distance to the oldest packet
+        if (start < 0 ? need > stream->ArenaSize : need >= start) {
+            return NULL;
+        }
+        memmove(stream->Arena, stream->Arena + pkt->Offset, pkt->Size);
+        pkt->Offset = 0;
+        return stream->Arena + pkt->Size;
+    }
+    if (pkt->Offset + need >= start) {
+        return NULL;
+    }
+    return stream->Arena + pkt->Offset + pkt->Size;
+}
+
+/**
+**  Check if the arena has no room for more input.
+**
+**  Only reported while the decoder has packets to decode, a single
+**  packet bigger than the arena is dropped instead.
+**
+**  @param stream   video stream
+**  @param size     number of bytes to append
+*/
+static int VideoArenaFull(VideoStream * stream, int size)
+{
+    if (!atomic_read(&stream->PacketsFilled)) {
+        return 0;
+    }
+    VideoArenaReclaim(stream);
+    return (stream->PacketWrite + VIDEO_PACKET_MAX - stream->PacketFree) % VIDEO_PACKET_MAX >= VIDEO_PACKET_MAX - 10
+        || VideoArenaFree(stream) < size + VIDEO_ARENA_RESERVE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Parameter set cache
+//////////////////////////////////////////////////////////////////////////////
+
+#define VIDEO_PARAM_CACHE_MAX 32        ///< channels in parameter set cache
+#define VIDEO_PARAM_SIZE_MAX 1024       ///< max bytes of cached parameter sets
+
+/**
+**  Cached H264/HEVC parameter sets of a channel.
+*/
+typedef struct _video_param_cache_
+{
+    uint32_t ChannelKey;                ///< hash of vdr channel id
+    enum AVCodecID CodecID;             ///< codec of parameter sets
+    uint32_t LastUse;                   ///< use counter for replacement
+    int Size;                           ///< bytes of parameter sets
+    uint8_t Data[VIDEO_PARAM_SIZE_MAX]; ///< parameter set nal units (annex b)
+} VideoParamCache;
+
+static VideoParamCache VideoParamCaches[VIDEO_PARAM_CACHE_MAX];   ///< last seen channels
+static uint32_t VideoParamUse;          ///< use counter of cache
+static volatile uint32_t VideoChannelKey;   ///< hash of live channel id, 0 none
+
+/**
+**  Set vdr channel id of the live video.
+**
+**  The parameter sets of the stream are cached per channel, after a
+**  channel switch the decoder is primed with them.
+**
+**  @param channel_id   vdr channel id string, NULL no live channel
+*/
+void SetVideoChannelId(const char *channel_id)
+{
+    uint32_t key;
+
+    key = 0;
+    if (channel_id) {
+        key = 2166136261U;              // FNV-1a
+        while (*channel_id) {
+            key = (key ^ (uint8_t) * channel_id++) * 16777619U;
+        }
+        if (!key) {
+            key = 1;
+        }
+    }
+    VideoChannelKey = key;
+}
+
+/**
+**  Lookup cached parameter sets.
+**
+**  @param key      hash of channel id
+**  @param codec_id codec id of stream
+**
+**  @returns cache entry, NULL if not cached.
+*/
+static VideoParamCache *VideoParamLookup(uint32_t key, int codec_id)
+{
+    int i;
+
+    for (i = 0; i < VIDEO_PARAM_CACHE_MAX; ++i) {
+        VideoParamCache *cache;
+
+        cache = &VideoParamCaches[i];
+        if (cache->ChannelKey == key && (int)cache->CodecID == codec_id && cache->Size) {
+            cache->LastUse = ++VideoParamUse;
+            return cache;
+        }
+    }
+    return NULL;
+}
+
+/**
+**  Learn parameter sets from a finished video packet.
+**
+**  Only the nal units in front of the first picture slice are checked,
+**  parameter sets are sent before the pictures using them.
+**
+**  @param codec_id codec id of packet
+**  @param data     packet data
+**  @param size     packet size
+*/
+static void VideoParamLearn(int codec_id, const uint8_t * data, int size)
+{
+    VideoParamCache *cache;
+    uint8_t buf[VIDEO_PARAM_SIZE_MAX];
+    uint32_t key;
+    int n;
+    int o;
+    int i;
+
+    if (!(key = VideoChannelKey)) {
+        return;
+    }
+
+    n = 0;
+    o = StartCodeFind(data, size - 1);
+    while (o >= 0) {
+        int type;
+        int next;
+        int end;
+
+        i = o + 3;                      // nal unit header
+        next = size - i - 1 >= 3 ? StartCodeFind(data + i, size - i - 1) : -1;
+        end = next >= 0 ? i + next : size;
+        if (codec_id == AV_CODEC_ID_H264) {
+            type = data[i] & 0x1F;
+            if (type >= 1 && type <= 5) {   // slice
+                break;
+            }
+            type = type == 7 || type == 8;  // SPS, PPS
+        } else {
+            type = (data[i] >> 1) & 0x3F;
+            if (type < 32) {            // slice
+                break;
+            }
+            type = type >= 32 && type <= 34;    // VPS, SPS, PPS
+        }
+        if (type) {
+            if (n + 1 + end - o > VIDEO_PARAM_SIZE_MAX) {
+                return;                 // too big for the cache
+            }
+            buf[n++] = 0x00;            // long start code
+            memcpy(buf + n, data + o, end - o);
+            n += end - o;
+        }
+        o = next >= 0 ? end : -1;
+    }
+    if (!n) {
+        return;
+    }
+
+    if (!(cache = VideoParamLookup(key, codec_id))) {
+        // replace least recently used entry
+        cache = VideoParamCaches;
+        for (i = 1; i < VIDEO_PARAM_CACHE_MAX; ++i) {
+            if (VideoParamCaches[i].LastUse < cache->LastUse) {
+                cache = &VideoParamCaches[i];
+            }
+        }
+        cache->ChannelKey = key;
+        cache->CodecID = codec_id;
+        cache->LastUse = ++VideoParamUse;
+        cache->Size = 0;
+    }
+    if (cache->Size != n || memcmp(cache->Data, buf, n)) {
+        memcpy(cache->Data, buf, n);
+        cache->Size = n;
     }
 }
 
@@ -1392,44 +2291,156 @@ static void VideoPacketExit(VideoStream * stream)
 */
 static void VideoEnqueue(VideoStream * stream, int64_t pts, int64_t dts, const void *data, int size)
 {
-    AVPacket *avpkt;
+    VideoPacket *pkt;
+    uint8_t *dst;
 
     // Debug(3, "video: enqueue %d\n", size);
 
-    avpkt = &stream->PacketRb[stream->PacketWrite];
-    if (!avpkt->stream_index) {         // add pts only for first added
-        avpkt->pts = pts;
-        avpkt->dts = dts;
+    pkt = &stream->PacketRb[stream->PacketWrite];
+    if (!pkt->Size) {                   // add pts only for first added
+        pkt->PTS = pts;
+        pkt->DTS = dts;
     }
 
-    if (avpkt->stream_index + size >= avpkt->size) {
-
-        // Warning(_("video: packet buffer too small for %d\n"),
-        // avpkt->stream_index + size);
-
-        // new + grow reserves FF_INPUT_BUFFER_PADDING_SIZE
-        av_grow_packet(avpkt, ((size + VIDEO_BUFFER_SIZE / 2)
-                / (VIDEO_BUFFER_SIZE / 2)) * (VIDEO_BUFFER_SIZE / 2));
-        // FIXME: out of memory!
-#ifdef DEBUG
-        if (avpkt->size <= avpkt->stream_index + size) {
-            fprintf(stderr, "%d %d %d\n", avpkt->size, avpkt->stream_index, size);
-            fflush(stderr);
-            abort();
-        }
-#endif
+    if (!(dst = VideoArenaReserve(stream, size))) {
+        Error(_("video: packet arena full, %d bytes lost\n"), size);
+        return;
     }
 
-    memcpy(avpkt->data + avpkt->stream_index, data, size);
-    avpkt->stream_index += size;
+    memcpy(dst, data, size);
+    pkt->Size += size;
 #ifdef DEBUG
-    if (avpkt->stream_index > VideoMaxPacketSize) {
-        VideoMaxPacketSize = avpkt->stream_index;
+    if (pkt->Size > VideoMaxPacketSize) {
+        VideoMaxPacketSize = pkt->Size;
         Debug(4, "video: max used PES packet size: %d\n", VideoMaxPacketSize);
     }
 #endif
 }
 
+/**
+**  Read unsigned exp-golomb code.
+**
+**  @param data bitstream data
+**  @param size size of data
+**  @param[in,out] bit  bit position in data
+*/
+static unsigned VideoReadGolomb(const uint8_t * data, int size, int *bit)
+{
+    int zeros;
+    unsigned val;
+
+    zeros = 0;
+    while (*bit < size * 8 && !(data[*bit >> 3] & (0x80 >> (*bit & 7)))) {
+        ++zeros;
+        ++*bit;
+    }
+    if (zeros > 31) {
+        return UINT32_MAX;
+    }
+    ++*bit;                             // stop bit
+    val = 1;
+    while (zeros-- > 0 && *bit < size * 8) {
+        val = (val << 1) | ((data[*bit >> 3] >> (7 - (*bit & 7))) & 1);
+        ++*bit;
+    }
+    return val - 1;
+}
+
+/**
+**  Classify the picture of a video packet for the key frame index.
+**
+**  Key pictures are H264 IDR and I slices, HEVC IRAP pictures and
+**  MPEG2 I pictures, they can be decoded without other pictures.
+**
+**  The discard level tells the overload governor, if the picture can
+**  be dropped: non-reference pictures at VIDEO_DISCARD_NONREF, other
+**  B pictures at VIDEO_DISCARD_BIDIR, like libavcodec skip_frame.
+**
+**  @param codec_id codec id of packet
+**  @param data packet data
+**  @param size size of packet data
+**  @param[out] discard lowest discard level dropping the picture, 0 never
+**
+**  @retval 1   key picture
+**  @retval -1  other picture
+**  @retval 0   no picture
+*/
+static int VideoPictureType(int codec_id, const uint8_t * data, int size, char *discard)
+{
+    int i;
+    int o;
+
+    *discard = 0;
+    i = 0;
+    while ((o = StartCodeFind(data + i, size - i - 1)) >= 0) {
+        const uint8_t *nal;
+        int type;
+
+        i += o + 3;
+        nal = data + i;
+        if (size - i < 8) {             // too short for a slice header
+            break;
+        }
+        switch (codec_id) {
+            case AV_CODEC_ID_MPEG2VIDEO:
+                if (nal[0] == 0x00) {   // picture start code
+                    type = (nal[2] >> 3) & 0x07;
+                    if (type == 3) {    // B pictures are never referenced
+                        *discard = VIDEO_DISCARD_NONREF;
+                    }
+                    return type == 1 ? 1 : -1;
+                }
+                break;
+            case AV_CODEC_ID_H264:
+                type = nal[0] & 0x1F;
+                if (type == 5) {        // IDR
+                    return 1;
+                }
+                if (type == 1) {        // slice, I or SI slice type
+                    int bit;
+                    unsigned slice_type;
+
+                    bit = 0;
+                    VideoReadGolomb(nal + 1, 7, &bit);  // first_mb_in_slice
+                    slice_type = VideoReadGolomb(nal + 1, 7, &bit) % 5;
+                    if (!(nal[0] & 0x60)) { // nal_ref_idc
+                        *discard = VIDEO_DISCARD_NONREF;
+                    } else if (slice_type == 1) {
+                        *discard = VIDEO_DISCARD_BIDIR;
+                    }
+                    return slice_type == 2 || slice_type == 4 ? 1 : -1;
+                }
+                if (type >= 2 && type <= 4) {   // data partition
+                    return -1;
+                }
+                break;
+            case AV_CODEC_ID_HEVC:
+                type = (nal[0] >> 1) & 0x3F;
+                if (type < 32) {        // IRAP 16-23
+                    if (type >= 16 && type <= 23) {
+                        return 1;
+                    }
+                    if (type <= 14 && !(type & 1)) {    // sub-layer non-reference
+                        *discard = VIDEO_DISCARD_NONREF;
+                    } else if (nal[2] & 0x80) { // first slice, no extra header bits
+                        int bit;
+
+                        bit = 1;
+                        VideoReadGolomb(nal + 2, 6, &bit);  // slice_pic_parameter_set_id
+                        if (!VideoReadGolomb(nal + 2, 6, &bit)) {   // B slice
+                            *discard = VIDEO_DISCARD_BIDIR;
+                        }
+                    }
+                    return -1;
+                }
+                break;
+            default:
+                return 0;
+        }
+    }
+    return 0;
+}
+
 /**
 **  Reset current packet.
 **
@@ -1437,57 +2448,271 @@ static void VideoEnqueue(VideoStream * stream, int64_t pts, int64_t dts, const v
 */
 static void VideoResetPacket(VideoStream * stream)
 {
-    AVPacket *avpkt;
+    VideoPacket *pkt;
 
     stream->StartCodeState = 0;         // reset start code state
+    stream->PacketPicture = 0;
+
+    pkt = &stream->PacketRb[stream->PacketWrite];
+    pkt->CodecID = AV_CODEC_ID_NONE;
+    pkt->Extradata = 0;
+    pkt->KeyFrame = 0;
+    pkt->Discard = 0;
+    pkt->Size = 0;
+    pkt->PTS = AV_NOPTS_VALUE;
+    pkt->DTS = AV_NOPTS_VALUE;
+}
+
+/**
+**  Finish current packet advance to next.
+**
+**  @param stream   video stream
+**  @param codec_id codec id of packet (MPEG/H264)
+*/
+static void VideoNextPacket(VideoStream * stream, int codec_id)
+{
+    VideoPacket *pkt;
+    int offset;
+
+    pkt = &stream->PacketRb[stream->PacketWrite];
+    if (!pkt->Size) {                   // ignore empty packets
+        if (codec_id != AV_CODEC_ID_NONE) {
+            return;
+        }
+        Debug(3, "video: possible stream change loss\n");
+    }
+
+    VideoArenaReclaim(stream);
+    if ((stream->PacketWrite + VIDEO_PACKET_MAX - stream->PacketFree) % VIDEO_PACKET_MAX >= VIDEO_PACKET_MAX - 1) {
+        // no free slot available drop last packet
+        Error(_("video: no empty slot in packet ringbuffer\n"));
+        pkt->Size = 0;
+        if (codec_id == AV_CODEC_ID_NONE) {
+            Debug(3, "video: possible stream change loss\n");
+        }
+        return;
+    }
+    offset = pkt->Offset;
+    if (pkt->Size) {
+        // clear area for decoder, reserved by VideoArenaReserve
+        memset(stream->Arena + pkt->Offset + pkt->Size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        offset += pkt->Size + AV_INPUT_BUFFER_PADDING_SIZE;
+        offset = (offset + VIDEO_ARENA_ALIGN - 1) & ~(VIDEO_ARENA_ALIGN - 1);
+        if (offset > stream->ArenaSize) {
+            offset = stream->ArenaSize;
+        }
+    }
+
+    pkt->CodecID = codec_id;
+    // DumpH264(stream->Arena + pkt->Offset, pkt->Size);
+    if (!pkt->Extradata) {              // key frame index for trick speed
+        pkt->KeyFrame = VideoPictureType(codec_id, stream->Arena + pkt->Offset, pkt->Size, &pkt->Discard);
+    }
+    if ((codec_id == AV_CODEC_ID_H264 || codec_id == AV_CODEC_ID_HEVC) && stream == MyVideoStream
+        && !pkt->Extradata) {
+        VideoParamLearn(codec_id, stream->Arena + pkt->Offset, pkt->Size);
+    }
+
+    // advance packet write
+    stream->PacketWrite = (stream->PacketWrite + 1) % VIDEO_PACKET_MAX;
+    atomic_inc(&stream->PacketsFilled);
+    VideoDisplayWakeup();
+
+    // intialize next package to use
+    stream->PacketRb[stream->PacketWrite].Offset = offset;
+    VideoResetPacket(stream);
+}
 
-    stream->CodecIDRb[stream->PacketWrite] = AV_CODEC_ID_NONE;
-    avpkt = &stream->PacketRb[stream->PacketWrite];
-    avpkt->stream_index = 0;
-    avpkt->pts = AV_NOPTS_VALUE;
-    avpkt->dts = AV_NOPTS_VALUE;
+/**
+**  Detect H264/HEVC stream without access unit delimiter.
+**
+**  Only parameter sets are trusted.  Their nal header bytes are also
+**  mpeg2 slice start codes (0x27, 0x47, 0x67 and 0x40), so the fixed
+**  fields of the parameter set must match too.
+**
+**  @param nal  nal unit header, after start code prefix (6 bytes)
+**
+**  @returns detected codec id, AV_CODEC_ID_NONE if unknown.
+*/
+static enum AVCodecID VideoNalDetect(const uint8_t * nal)
+{
+    // H264 NAL SPS sequence parameter set, nal_ref_idc != 0
+    if ((nal[0] & 0x9F) == 0x07 && (nal[0] & 0x60)) {
+        // profile_idc, reserved_zero_2bits and level_idc (1b .. 6.2)
+        switch (nal[1]) {
+            case 44:                   // CAVLC 4:4:4 intra
+            case 66:                   // baseline
+            case 77:                   // main
+            case 88:                   // extended
+            case 100:                  // high
+            case 110:                  // high 10
+            case 118:                  // multiview high
+            case 122:                  // high 4:2:2
+            case 128:                  // stereo high
+            case 244:                  // high 4:4:4
+                if (!(nal[2] & 0x03) && nal[3] >= 9 && nal[3] <= 62) {
+                    return AV_CODEC_ID_H264;
+                }
+                break;
+            default:
+                break;
+        }
+        return AV_CODEC_ID_NONE;
+    }
+    // HEVC NAL VPS video parameter set, vps_reserved_0xffff_16bits
+    if (nal[0] == 0x40 && nal[1] == 0x01 && nal[4] == 0xFF && nal[5] == 0xFF) {
+        return AV_CODEC_ID_HEVC;
+    }
+    return AV_CODEC_ID_NONE;
+}
+
+/**
+**  Check if H264/HEVC NAL unit starts a new access unit.
+**
+**  @param codec_id codec id of stream
+**  @param nal  nal unit header, after start code prefix (3 bytes)
+*/
+static int VideoNalAccessUnitStart(int codec_id, const uint8_t * nal)
+{
+    int type;
+
+    if (codec_id == AV_CODEC_ID_H264) {
+        type = nal[0] & 0x1F;
+        switch (type) {
+            case 1:                    // slice with first_mb_in_slice == 0
+            case 5:
+                return nal[1] & 0x80;
+            case 6:                    // SEI, SPS, PPS, AUD
+            case 7:
+            case 8:
+            case 9:
+            case 14:                   // prefix, subset SPS, reserved
+            case 15:
+            case 16:
+            case 17:
+            case 18:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+    type = (nal[0] >> 1) & 0x3F;
+    if (type < 32) {                    // slice with first_slice_segment_in_pic_flag
+        return nal[2] & 0x80;
+    }
+    // VPS, SPS, PPS, AUD, prefix SEI, reserved
+    return type <= 35 || type == 39 || (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+}
+
+/**
+**  Check if H264/HEVC data contains a coded picture (VCL NAL unit).
+**
+**  @param codec_id codec id of stream
+**  @param data elementary stream data
+**  @param size size of data
+*/
+static int VideoNalHasPicture(int codec_id, const uint8_t * data, int size)
+{
+    int i;
+    int o;
+
+    i = 0;
+    while ((o = StartCodeFind(data + i, size - i - 1)) >= 0) {
+        int type;
+
+        i += o + 3;                     // nal unit header
+        if (codec_id == AV_CODEC_ID_H264) {
+            type = data[i] & 0x1F;
+            if (type >= 1 && type <= 5) {
+                return 1;
+            }
+        } else if (((data[i] >> 1) & 0x3F) < 32) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+**  Check if a H264/HEVC PES packet starts a new access unit.
+**
+**  After the last packet was finished at the end of its PES packet,
+**  the new PES packet must start a new access unit.  If not, the
+**  stream doesn't align the pictures to the PES packets and the
+**  packets are again finished by the next access unit only.  The
+**  first PES start of a stream is checked before any packet is
+**  finished at a PES end.
+**
+**  @param stream   video stream
+**  @param check    PES payload after leading zeros
+**  @param z    number of leading zeros
+**  @param l    size of payload after leading zeros
+*/
+static void VideoAccessUnitCheck(VideoStream * stream, const uint8_t * check, int z, int l)
+{
+    if (stream->CodecID != AV_CODEC_ID_H264 && stream->CodecID != AV_CODEC_ID_HEVC) {
+        return;
+    }
+    if (!stream->PesCut && (stream->PesAligned || stream->NoPesCut)) {
+        return;
+    }
+    stream->PesCut = 0;
+    if (z >= 2 && l >= 4 && check[0] == 0x01 && VideoNalAccessUnitStart(stream->CodecID, check + 1)) {
+        stream->PesAligned = 1;
+        return;
+    }
+    Debug(3, "video: pictures not aligned to PES packets\n");
+    stream->NoPesCut = 1;
+}
+
+/**
+**  Finish the H264/HEVC packet at the end of the PES packet.
+**
+**  Broadcasters send one picture per PES packet.  When the PES packet
+**  is complete and contains a picture, the access unit is complete and
+**  needs not to wait for the start of the next picture.
+**
+**  @param stream   video stream
+**  @param data elementary stream data just enqueued
+**  @param size size of data
+**  @param pes_end  flag data is the end of the PES packet
+*/
+static void VideoAccessUnitEnd(VideoStream * stream, const uint8_t * data, int size, int pes_end)
+{
+    if (stream->CodecID != AV_CODEC_ID_H264 && stream->CodecID != AV_CODEC_ID_HEVC) {
+        return;
+    }
+    if (!stream->PacketPicture && size > 0) {
+        stream->PacketPicture = VideoNalHasPicture(stream->CodecID, data, size);
+    }
+    if (pes_end && stream->PacketPicture && stream->PesAligned && !stream->NoPesCut) {
+        VideoNextPacket(stream, stream->CodecID);
+        stream->PesCut = 1;
+    }
 }
 
 /**
-**  Finish current packet advance to next.
+**  Prime the decoder with the cached parameter sets of the channel.
+**
+**  Called when the codec of a new stream is detected.  The parameter
+**  sets are queued as own packet, the decoder uses them as extradata.
 **
 **  @param stream   video stream
-**  @param codec_id codec id of packet (MPEG/H264)
 */
-static void VideoNextPacket(VideoStream * stream, int codec_id)
+static void VideoParamPrime(VideoStream * stream)
 {
-    AVPacket *avpkt;
+    const VideoParamCache *cache;
 
-    avpkt = &stream->PacketRb[stream->PacketWrite];
-    if (!avpkt->stream_index) {         // ignore empty packets
-        if (codec_id != AV_CODEC_ID_NONE) {
-            return;
-        }
-        Debug(3, "video: possible stream change loss\n");
+    if (stream != MyVideoStream || !VideoChannelKey || stream->PacketRb[stream->PacketWrite].Size) {
+        return;
     }
-
-    if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 1) {
-        // no free slot available drop last packet
-        Error(_("video: no empty slot in packet ringbuffer\n"));
-        avpkt->stream_index = 0;
-        if (codec_id == AV_CODEC_ID_NONE) {
-            Debug(3, "video: possible stream change loss\n");
-        }
+    if (!(cache = VideoParamLookup(VideoChannelKey, stream->CodecID))) {
         return;
     }
-    // clear area for decoder, always enough space allocated
-    memset(avpkt->data + avpkt->stream_index, 0, AV_INPUT_BUFFER_PADDING_SIZE);
-
-    stream->CodecIDRb[stream->PacketWrite] = codec_id;
-    // DumpH264(avpkt->data, avpkt->stream_index);
-
-    // advance packet write
-    stream->PacketWrite = (stream->PacketWrite + 1) % VIDEO_PACKET_MAX;
-    atomic_inc(&stream->PacketsFilled);
-    VideoDisplayWakeup();
-
-    // intialize next package to use
-    VideoResetPacket(stream);
+    Debug(3, "video: prime decoder with %d bytes parameter sets\n", cache->Size);
+    VideoEnqueue(stream, AV_NOPTS_VALUE, AV_NOPTS_VALUE, cache->Data, cache->Size);
+    stream->PacketRb[stream->PacketWrite].Extradata = 1;
+    VideoNextPacket(stream, stream->CodecID);
 }
 
 #ifdef USE_PIP
@@ -1499,8 +2724,6 @@ static void VideoNextPacket(VideoStream * stream, int codec_id)
 **  Split the packet into single picture packets.
 **  Nick/CC, Viva, MediaShop, Deutsches Music Fernsehen
 **
-**  FIXME: this code can be written much faster
-**
 **  @param stream   video stream
 **  @param pts  presentation timestamp of pes packet
 **  @param data data of pes packet
@@ -1514,7 +2737,7 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts, int64_t dts, con
     int first;
 
     // first scan
-    first = !stream->PacketRb[stream->PacketWrite].stream_index;
+    first = !stream->PacketRb[stream->PacketWrite].Size;
     p = data;
     n = size;
 
@@ -1535,7 +2758,7 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts, int64_t dts, con
 #ifdef DEBUG
                 printf("last: %d start  aspect %02x\n", stream->StartCodeState, p[4]);
 #endif
-                stream->PacketRb[stream->PacketWrite].stream_index -= 3;
+                stream->PacketRb[stream->PacketWrite].Size -= 3;
                 VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
                 VideoEnqueue(stream, pts, dts, startcode, 3);
                 first = p[0] == 0xb3;
@@ -1553,7 +2776,7 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts, int64_t dts, con
 #ifdef DEBUG
                 printf("last: %d start  aspect %02x\n", stream->StartCodeState, p[5]);
 #endif
-                stream->PacketRb[stream->PacketWrite].stream_index -= 2;
+                stream->PacketRb[stream->PacketWrite].Size -= 2;
                 VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
                 VideoEnqueue(stream, pts, dts, startcode, 2);
                 first = p[1] == 0xb3;
@@ -1570,7 +2793,7 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts, int64_t dts, con
 #ifdef DEBUG
                 printf("last: %d start  aspect %02x\n", stream->StartCodeState, p[6]);
 #endif
-                stream->PacketRb[stream->PacketWrite].stream_index -= 1;
+                stream->PacketRb[stream->PacketWrite].Size -= 1;
                 VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
                 VideoEnqueue(stream, pts, dts, startcode, 1);
                 first = p[2] == 0xb3;
@@ -1585,12 +2808,20 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts, int64_t dts, con
     // b3 b4 b8 00 b5 ... 00 b5 ...
 
     while (n > 3) {
-        if (0 && !p[0] && !p[1] && p[2] == 0x01) {
-            fprintf(stderr, " %02x", p[3]);
+        int o;
+
+        // scan for next start code, keep last 3 bytes for packet border
+        o = StartCodeFind(p, n);
+        if (o < 0 || o + 3 >= n) {
+            p += n - 3;
+            n = 3;
+            break;
         }
+        p += o;
+        n -= o;
         // scan for picture header 0x00000100
         // FIXME: not perfect, must split at 0xb3 also
-        if (!p[0] && !p[1] && p[2] == 0x01 && !p[3]) {
+        if (!p[3]) {
             if (first) {
                 first = 0;
                 n -= 4;
@@ -1617,11 +2848,9 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts, int64_t dts, con
             p += 4;
             continue;
         }
-        if (!p[0] && !p[1] && p[2] == 0x01 && p[3] == 0xb3) {
-            // printf("aspectratio %02x\n",p[7]>>4);
-        }
-        --n;
-        ++p;
+        // 0x00 0x00 0x01 can't start again in the next two bytes
+        n -= 3;
+        p += 3;
     }
 
     stream->StartCodeState = 0;
@@ -1766,6 +2995,7 @@ static void VideoStreamClose(VideoStream * stream, int delhw)
         stream->Decoder = NULL;         // lock read thread
         pthread_mutex_unlock(&stream->DecoderLockMutex);
         CodecVideoClose(decoder);
+        // parked contexts are freed here, before the packet arena
         CodecVideoDelDecoder(decoder);
     }
     if (stream->HwDecoder) {
@@ -1823,6 +3053,60 @@ int VideoPollInput(VideoStream * stream)
     return 1;
 }
 
+/**
+**  Overload governor, select the picture discard level.
+**
+**  When the video falls behind audio and there are pictures queued,
+**  non-reference pictures and then all B pictures are dropped before
+**  decode.  This saves decode and upload time, instead of dropping
+**  finished frames at display.  The level steps back down, once the
+**  video is in sync again.  Levels are held some pictures, so the
+**  smoothed audio/video difference can follow.
+**
+**  With video master sync audio is resampled to follow the video
+**  within 100ms, pictures are only dropped outside this window.
+**
+**  @param stream   video stream
+**  @param filled   packets in ring buffer
+*/
+static void VideoDiscardGovernor(VideoStream * stream, int filled)
+{
+    static const enum AVDiscard discard[] = { AVDISCARD_DEFAULT, AVDISCARD_NONREF, AVDISCARD_BIDIR };
+    int level;
+    int diff;
+    int late;
+    int synced;
+    int master;
+
+    level = stream->DiscardLevel;
+    diff = 0;
+    if (stream->TrickSpeed) {
+        level = 0;
+    } else if (stream->DiscardHold > 0) {
+        --stream->DiscardHold;
+        return;
+    } else {
+        diff = VideoGetAVDiff(stream->HwDecoder);
+        late = VIDEO_DISCARD_LATE;
+        synced = VIDEO_DISCARD_SYNCED;
+        if (VideoGetMasterSyncDiff(&master)) {
+            late = VIDEO_DISCARD_MASTER_LATE;
+            synced = VIDEO_DISCARD_MASTER_SYNCED;
+        }
+        if (diff < late && filled > 3 && level < VIDEO_DISCARD_BIDIR) {
+            ++level;
+        } else if ((diff > synced || filled <= 1) && level > 0) {
+            --level;
+        }
+    }
+    if (level != stream->DiscardLevel) {
+        Debug(3, "video: discard level %d, %dms late %d packets\n", level, -diff, filled);
+        stream->DiscardLevel = level;
+        stream->DiscardHold = VIDEO_DISCARD_HOLD;
+        CodecVideoSetDiscard(stream->Decoder, discard[level]);
+    }
+}
+
 /**
 **  Decode from PES packet ringbuffer.
 **
@@ -1835,8 +3119,9 @@ int VideoPollInput(VideoStream * stream)
 int VideoDecodeInput(VideoStream * stream)
 {
     int filled;
-    AVPacket *avpkt;
-    int saved_size;
+    VideoPacket *pkt;
+    AVPacket avpkt[1];
+    int extradata;
 
     if (!stream->Decoder) {             // closing
 #ifdef DEBUG
@@ -1881,7 +3166,7 @@ int VideoDecodeInput(VideoStream * stream)
 
         // flush buffers, if close is in the queue
         for (f = 0; f < filled; ++f) {
-            if (stream->CodecIDRb[(stream->PacketRead + f) % VIDEO_PACKET_MAX] == AV_CODEC_ID_NONE) {
+            if (stream->PacketRb[(stream->PacketRead + f) % VIDEO_PACKET_MAX].CodecID == AV_CODEC_ID_NONE) {
                 if (f) {
                     Debug(3, "video: cleared upto close\n");
                     atomic_sub(f, &stream->PacketsFilled);
@@ -1898,8 +3183,20 @@ int VideoDecodeInput(VideoStream * stream)
     //
     //  handle queued commands
     //
-    avpkt = &stream->PacketRb[stream->PacketRead];
-    switch (stream->CodecIDRb[stream->PacketRead]) {
+    pkt = &stream->PacketRb[stream->PacketRead];
+    extradata = 0;
+    if (pkt->Extradata && pkt->CodecID != stream->LastCodecID) {
+        // cached parameter sets, used when the codec is opened
+        CodecVideoSetExtradata(stream->Decoder, stream->Arena + pkt->Offset, pkt->Size);
+        extradata = 1;
+    }
+    if (pkt->CodecID != stream->LastCodecID) {  // new context decodes all
+        stream->DiscardLevel = 0;
+        stream->DiscardHold = 0;
+        stream->Discarded[0] = 0;       // statistics are per stream
+        stream->Discarded[1] = 0;
+    }
+    switch (pkt->CodecID) {
         case AV_CODEC_ID_NONE:
             stream->ClosingStream = 0;
             if (stream->LastCodecID != AV_CODEC_ID_NONE) {
@@ -1934,11 +3231,49 @@ int VideoDecodeInput(VideoStream * stream)
         default:
             break;
     }
+    if (extradata) {
+        goto skip;
+    }
+    if (stream->TrickKeyFrames && pkt->KeyFrame) {
+        if (pkt->KeyFrame < 0) {
+            // skip to the next key picture, others are not shown at fast speed
+            do {
+                ++stream->TrickSkipped;
+                stream->PacketRead = (stream->PacketRead + 1) % VIDEO_PACKET_MAX;
+                atomic_dec(&stream->PacketsFilled);
+                pkt = &stream->PacketRb[stream->PacketRead];
+            } while (--filled && pkt->KeyFrame < 0);
+            return 0;
+        }
+        if (pkt->PTS != (int64_t) AV_NOPTS_VALUE) {
+            if (stream->TrickFirstPTS == (int64_t) AV_NOPTS_VALUE) {
+                stream->TrickFirstPTS = pkt->PTS;
+            }
+            stream->TrickLastPTS = pkt->PTS;
+        }
+        ++stream->TrickDecoded;
+    }
+    if (pkt->KeyFrame) {
+        VideoDiscardGovernor(stream, filled);
+        if (pkt->Discard && pkt->Discard <= stream->DiscardLevel) {
+            // drop it here too, not every decoder honors skip_frame
+            ++stream->Discarded[stream->DiscardLevel - 1];
+            goto skip;
+        }
+    }
 
-    // avcodec_decode_video2 needs size
-    saved_size = avpkt->size;
-    avpkt->size = avpkt->stream_index;
-    avpkt->stream_index = 0;
+    // reference the arena, the decoder can keep the data without copy
+    av_init_packet(avpkt);
+    avpkt->data = stream->Arena + pkt->Offset;
+    avpkt->size = pkt->Size;
+    avpkt->pts = pkt->PTS;
+    avpkt->dts = pkt->DTS;
+    pkt->Held = 1;
+    avpkt->buf =
+        av_buffer_create(avpkt->data, pkt->Size + AV_INPUT_BUFFER_PADDING_SIZE, VideoPacketRelease, pkt, 0);
+    if (!avpkt->buf) {                  // decoder copies the data
+        pkt->Held = 0;
+    }
 
 #ifdef USE_PIP
     // fprintf(stderr, "[");
@@ -1963,8 +3298,7 @@ int VideoDecodeInput(VideoStream * stream)
         CodecVideoDecode(stream->Decoder, avpkt);
     }
 #endif
-
-    avpkt->size = saved_size;
+    av_buffer_unref(&avpkt->buf);       // decoder holds its own references
 
   skip:
     // advance packet read
@@ -2162,6 +3496,9 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
         stream->CodecID = AV_CODEC_ID_NONE;
         stream->ClosingStream = 1;
         stream->NewStream = 0;
+        stream->PesCut = 0;
+        stream->NoPesCut = 0;
+        stream->PesAligned = 0;
     }
     // must be a PES start code
     // FIXME: Valgrind-3.8.1 has a problem with this code
@@ -2192,7 +3529,7 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
         return size;
     }
     // hard limit buffer full: needed for replay
-    if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 10) {
+    if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 10 || VideoArenaFull(stream, size)) {
         // Debug(3, "video: video buffer full\n");
         return 0;
     }
@@ -2222,17 +3559,15 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
 
     check = data + 9 + n;
     l = size - 9 - n;
-    z = 0;
-    while (!*check) {                   // count leading zeros
-        if (l < 3) {
-            // Warning(_("[softhddev] empty video packet %d bytes\n"), size);
-            z = 0;
-            break;
-        }
-        --l;
-        ++check;
-        ++z;
+    z = StartCodeZeros(check, l);       // count leading zeros
+    if (l - z < 2) {
+        // Warning(_("[softhddev] empty video packet %d bytes\n"), size);
+        z = 0;
+    } else {
+        check += z;
+        l -= z;
     }
+    VideoAccessUnitCheck(stream, check, z, l);
 
     // H264 NAL AUD Access Unit Delimiter (0x00) 0x00 0x00 0x01 0x09
     // and next start code
@@ -2255,15 +3590,291 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
             }
 #endif
 #ifdef H264_EOS_TRICKSPEED
-            // this should improve ffwd+frew, but produce crash in ffmpeg
-            // with some streams
+            // this should improve ffwd+frew, but produce crash in ffmpeg
+            // with some streams
+            if (stream->TrickSpeed && pts != (int64_t) AV_NOPTS_VALUE) {
+                // H264 NAL End of Sequence
+                static uint8_t seq_end_h264[] = { 0x00, 0x00, 0x00, 0x01, 0x0A };
+
+                // 1-5=SLICE 6=SEI 7=SPS 8=PPS
+                // NAL SPS sequence parameter set
+                if ((check[7] & 0x1F) == 0x07) {
+                    VideoNextPacket(stream, AV_CODEC_ID_H264);
+                    VideoEnqueue(stream, AV_NOPTS_VALUE, AV_NOPTS_VALUE, seq_end_h264, sizeof(seq_end_h264));
+                }
+            }
+#endif
+            VideoNextPacket(stream, AV_CODEC_ID_H264);
+        } else {
+            Debug(3, "video: h264 detected\n");
+            stream->CodecID = AV_CODEC_ID_H264;
+            VideoParamPrime(stream);
+        }
+        // SKIP PES header (ffmpeg supports short start code)
+        VideoEnqueue(stream, pts, dts, check - 2, l + 2);
+        // vdr splits PES packets, smaller is the last piece
+        VideoAccessUnitEnd(stream, check - 2, l + 2, size < 65526);
+        return size;
+    }
+    // HEVC Codec
+    if ((data[6] & 0xC0) == 0x80 && z >= 2 && check[0] == 0x01 && check[1] == 0x46) {
+        // old PES HDTV recording z == 2 -> stronger check!
+        if (stream->CodecID == AV_CODEC_ID_HEVC) {
+            VideoNextPacket(stream, AV_CODEC_ID_HEVC);
+        } else {
+            Debug(3, "video: hvec detected\n");
+            stream->CodecID = AV_CODEC_ID_HEVC;
+            VideoParamPrime(stream);
+        }
+        // SKIP PES header (ffmpeg supports short start code)
+        VideoEnqueue(stream, pts, dts, check - 2, l + 2);
+        VideoAccessUnitEnd(stream, check - 2, l + 2, size < 65526);
+        return size;
+    }
+
+    // PES start code 0x00 0x00 0x01 0x00|0xb3
+    if (z > 1 && check[0] == 0x01 && (!check[1] || check[1] == 0xb3)) {
+        if (stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
+            VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
+        } else {
+            Debug(3, "video: mpeg2 detected ID %02x\n", check[3]);
+            stream->CodecID = AV_CODEC_ID_MPEG2VIDEO;
+        }
+
+        // SKIP PES header, begin of start code
+#ifdef USE_PIP
+        VideoMpegEnqueue(stream, pts, dts, check - 2, l + 2);
+#else
+        VideoEnqueue(stream, pts, dts, check - 2, l + 2);
+#endif
+        return size;
+    }
+    // H264/HEVC without access unit delimiter, new picture at PES start
+    if ((data[7] & 0x80) && z >= 2 && l >= 4 && check[0] == 0x01) {
+        if (stream->CodecID == AV_CODEC_ID_NONE && l >= 7 && (stream->CodecID = VideoNalDetect(check + 1))) {
+            Debug(3, "video: %s without AUD detected\n", stream->CodecID == AV_CODEC_ID_H264 ? "h264" : "hevc");
+            VideoParamPrime(stream);
+            VideoEnqueue(stream, pts, dts, check - 2, l + 2);
+            VideoAccessUnitEnd(stream, check - 2, l + 2, size < 65526);
+            return size;
+        }
+        if ((stream->CodecID == AV_CODEC_ID_H264 || stream->CodecID == AV_CODEC_ID_HEVC)
+            && VideoNalAccessUnitStart(stream->CodecID, check + 1)) {
+            VideoNextPacket(stream, stream->CodecID);
+            VideoEnqueue(stream, pts, dts, check - 2, l + 2);
+            VideoAccessUnitEnd(stream, check - 2, l + 2, size < 65526);
+            return size;
+        }
+    }
+    // this happens when vdr sends incomplete packets
+    if (stream->CodecID == AV_CODEC_ID_NONE) {
+        Debug(3, "video: not detected\n");
+        return size;
+    }
+
+#ifdef USE_PIP
+    if (stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
+        // SKIP PES header
+        VideoMpegEnqueue(stream, pts, dts, data + 9 + n, size - 9 - n);
+#ifndef USE_MPEG_COMPLETE
+        if (size < 65526) {
+            // mpeg codec supports incomplete packets
+            // waiting for a full complete packages, increases needed delays
+            // PES recordings sends incomplete packets
+            // incomplete packets  breaks the decoder for some stations
+            // for the new USE_PIP code, this is only a very little improvement
+            VideoNextPacket(stream, stream->CodecID);
+        }
+#endif
+    } else {
+        // SKIP PES header
+        VideoEnqueue(stream, pts, dts, data + 9 + n, size - 9 - n);
+        VideoAccessUnitEnd(stream, data + 9 + n, size - 9 - n, size < 65526);
+    }
+#else
+
+    // SKIP PES header
+    VideoEnqueue(stream, pts, dts, data + 9 + n, size - 9 - n);
+    VideoAccessUnitEnd(stream, data + 9 + n, size - 9 - n, size < 65526);
+
+    // incomplete packets produce artefacts after channel switch
+    // packet < 65526 is the last split packet, detect it here for
+    // better latency
+    if (size < 65526 && stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
+        // mpeg codec supports incomplete packets
+        // waiting for a full complete packages, increases needed delays
+        VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
+    }
+#endif
+
+    return size;
+}
+
+/**
+**  Play video packet.
+**
+**  @param data data of exactly one complete PES packet
+**  @param size size of PES packet
+**
+**  @return number of bytes used, 0 if internal buffer are full.
+**
+**  @note vdr sends incomplete packets, va-api h264 decoder only
+**  supports complete packets.
+**  We buffer here until we receive an complete PES Packet, which
+**  is no problem, the audio is always far behind us.
+**  cTsToPes::GetPes splits the packets.
+**
+**  @todo FIXME: combine the 5 ifs at start of the function
+*/
+int PlayVideo(const uint8_t * data, int size)
+{
+    return PlayVideo3(MyVideoStream, data, size);
+}
+
+#ifdef USE_TS_VIDEO
+
+//////////////////////////////////////////////////////////////////////////////
+//  Transport stream video demux
+//////////////////////////////////////////////////////////////////////////////
+
+#ifdef NO_TS_AUDIO
+/// Transport stream packet size
+#define TS_PACKET_SIZE  188
+/// Transport stream packet sync byte
+#define TS_PACKET_SYNC  0x47
+#endif
+
+/// elementary stream bytes needed after the PES header for codec detection
+#define TS_VIDEO_PROBE_SIZE 8
+
+///
+/// TS video demuxer state.
+///
+enum
+{
+    TS_VIDEO_SKIP,                      ///< wait for payload unit start
+    TS_VIDEO_HEADER,                    ///< collect pes header + probe
+    TS_VIDEO_PAYLOAD,                   ///< pass payload to packet ring
+};
+
+///
+/// Transport stream video demuxer.
+///
+/// Reassembles the video TS packets directly into the video packet
+/// ringbuffer, without the cTsToPes + PlayVideo3 round trip.
+///
+typedef struct _ts_video_demux_
+{
+    int State;                          ///< parsing state
+    int Pid;                            ///< video pid, -1 unknown
+    int Continuity;                     ///< last continuity counter, -1 unknown
+    int Discontinuities;                ///< counter of continuity errors
+    uint8_t Header[9 + 256 + TS_VIDEO_PROBE_SIZE];  ///< pes header + probe
+    int HeaderIndex;                    ///< header index
+    int HeaderSize;                     ///< needed header bytes
+    int PesSize;                        ///< remaining pes bytes, -1 unbounded
+} TsVideoDemux;
+
+static TsVideoDemux TsDemuxVideo[1];    ///< ts video demuxer
+
+///
+/// Reset transport stream video demuxer.
+///
+/// @param tsvdx    transport stream video demuxer
+///
+static void TsVideoReset(TsVideoDemux * tsvdx)
+{
+    tsvdx->State = TS_VIDEO_SKIP;
+    tsvdx->Pid = -1;
+    tsvdx->Continuity = -1;
+    tsvdx->HeaderIndex = 0;
+    tsvdx->HeaderSize = 9;
+    tsvdx->PesSize = -1;
+}
+
+///
+/// Place TS video payload into the packet ringbuffer.
+///
+/// @param stream   video stream
+/// @param pts  presentation timestamp of pes packet
+/// @param dts  decode timestamp of pes packet
+/// @param data elementary stream data
+/// @param size size of data
+///
+static void TsVideoEnqueue(VideoStream * stream, int64_t pts, int64_t dts, const uint8_t * data, int size)
+{
+    if (size <= 0) {
+        return;
+    }
+#ifdef USE_PIP
+    if (stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
+        VideoMpegEnqueue(stream, pts, dts, data, size);
+        return;
+    }
+#endif
+    VideoEnqueue(stream, pts, dts, data, size);
+    VideoAccessUnitEnd(stream, data, size, 0);
+}
+
+///
+/// Handle collected PES header and start of the elementary stream.
+///
+/// Same codec detection as PlayVideo3, but the pes header is only
+/// parsed once here and the payload comes straight from the TS packets.
+///
+/// @param stream   video stream
+/// @param tsvdx    transport stream video demuxer
+///
+static void TsVideoPesStart(VideoStream * stream, TsVideoDemux * tsvdx)
+{
+    const uint8_t *data;
+    const uint8_t *check;
+    int64_t pts;
+    int64_t dts;
+    int n;
+    int l;
+    int z;
+
+    data = tsvdx->Header;
+    tsvdx->State = TS_VIDEO_PAYLOAD;
+
+    n = data[8];                        // header size
+    l = tsvdx->HeaderIndex - 9 - n;
+    if (l <= 0) {                       // empty or truncated pes packet
+        tsvdx->State = TS_VIDEO_SKIP;
+        return;
+    }
+
+    pts = AV_NOPTS_VALUE;
+    dts = AV_NOPTS_VALUE;
+    if ((data[7] & 0x80) && n >= 5) {
+        pts =
+            (int64_t) (data[9] & 0x0E) << 29 | data[10] << 22 | (data[11] & 0xFE) << 14 | data[12] << 7 | (data[13] &
+            0xFE) >> 1;
+    }
+    if ((data[7] & 0xC0) == 0xc0 && n >= 10) {
+        dts =
+            (int64_t) (data[14] & 0x0E) << 29 | data[15] << 22 | (data[16] & 0xFE) << 14 | data[17] << 7 | (data[18] &
+            0xFE) >> 1;
+    }
+
+    check = data + 9 + n;
+    z = StartCodeZeros(check, l - 2);   // count leading zeros
+    check += z;
+    l -= z;
+    VideoAccessUnitCheck(stream, check, z, l);
+
+    // H264 NAL AUD Access Unit Delimiter (0x00) 0x00 0x00 0x01 0x09
+    if ((data[6] & 0xC0) == 0x80 && z >= 2 && l >= 5 && check[0] == 0x01 && check[1] == 0x09 && !check[3]
+        && !check[4]) {
+        if (stream->CodecID == AV_CODEC_ID_H264) {
+#ifdef H264_EOS_TRICKSPEED
             if (stream->TrickSpeed && pts != (int64_t) AV_NOPTS_VALUE) {
                 // H264 NAL End of Sequence
                 static uint8_t seq_end_h264[] = { 0x00, 0x00, 0x00, 0x01, 0x0A };
 
-                // 1-5=SLICE 6=SEI 7=SPS 8=PPS
                 // NAL SPS sequence parameter set
-                if ((check[7] & 0x1F) == 0x07) {
+                if (l >= 8 && (check[7] & 0x1F) == 0x07) {
                     VideoNextPacket(stream, AV_CODEC_ID_H264);
                     VideoEnqueue(stream, AV_NOPTS_VALUE, AV_NOPTS_VALUE, seq_end_h264, sizeof(seq_end_h264));
                 }
@@ -2271,107 +3882,307 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
 #endif
             VideoNextPacket(stream, AV_CODEC_ID_H264);
         } else {
-            Debug(3, "video: h264 detected\n");
+            Debug(3, "video/ts: h264 detected\n");
             stream->CodecID = AV_CODEC_ID_H264;
+            VideoParamPrime(stream);
         }
-        // SKIP PES header (ffmpeg supports short start code)
-        VideoEnqueue(stream, pts, dts, check - 2, l + 2);
-        return size;
+        TsVideoEnqueue(stream, pts, dts, check - 2, l + 2);
+        return;
     }
     // HEVC Codec
-    if ((data[6] & 0xC0) == 0x80 && z >= 2 && check[0] == 0x01 && check[1] == 0x46) {
-        // old PES HDTV recording z == 2 -> stronger check!
+    if ((data[6] & 0xC0) == 0x80 && z >= 2 && l >= 2 && check[0] == 0x01 && check[1] == 0x46) {
         if (stream->CodecID == AV_CODEC_ID_HEVC) {
             VideoNextPacket(stream, AV_CODEC_ID_HEVC);
         } else {
-            Debug(3, "video: hvec detected\n");
+            Debug(3, "video/ts: hevc detected\n");
             stream->CodecID = AV_CODEC_ID_HEVC;
+            VideoParamPrime(stream);
         }
-        // SKIP PES header (ffmpeg supports short start code)
-        VideoEnqueue(stream, pts, dts, check - 2, l + 2);
-        return size;
+        TsVideoEnqueue(stream, pts, dts, check - 2, l + 2);
+        return;
     }
-
     // PES start code 0x00 0x00 0x01 0x00|0xb3
-    if (z > 1 && check[0] == 0x01 && (!check[1] || check[1] == 0xb3)) {
+    if (z > 1 && l >= 2 && check[0] == 0x01 && (!check[1] || check[1] == 0xb3)) {
         if (stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
             VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
         } else {
-            Debug(3, "video: mpeg2 detected ID %02x\n", check[3]);
+            Debug(3, "video/ts: mpeg2 detected\n");
             stream->CodecID = AV_CODEC_ID_MPEG2VIDEO;
         }
-
-        // SKIP PES header, begin of start code
-#ifdef USE_PIP
-        VideoMpegEnqueue(stream, pts, dts, check - 2, l + 2);
-#else
-        VideoEnqueue(stream, pts, dts, check - 2, l + 2);
-#endif
-        return size;
+        TsVideoEnqueue(stream, pts, dts, check - 2, l + 2);
+        return;
+    }
+    // H264/HEVC without access unit delimiter, new picture at PES start
+    if ((data[7] & 0x80) && z >= 2 && l >= 4 && check[0] == 0x01) {
+        if (stream->CodecID == AV_CODEC_ID_NONE && l >= 7 && (stream->CodecID = VideoNalDetect(check + 1))) {
+            Debug(3, "video/ts: %s without AUD detected\n", stream->CodecID == AV_CODEC_ID_H264 ? "h264" : "hevc");
+            VideoParamPrime(stream);
+            TsVideoEnqueue(stream, pts, dts, check - 2, l + 2);
+            return;
+        }
+        if ((stream->CodecID == AV_CODEC_ID_H264 || stream->CodecID == AV_CODEC_ID_HEVC)
+            && VideoNalAccessUnitStart(stream->CodecID, check + 1)) {
+            VideoNextPacket(stream, stream->CodecID);
+            TsVideoEnqueue(stream, pts, dts, check - 2, l + 2);
+            return;
+        }
     }
-    // this happens when vdr sends incomplete packets
     if (stream->CodecID == AV_CODEC_ID_NONE) {
-        Debug(3, "video: not detected\n");
-        return size;
+        Debug(3, "video/ts: not detected\n");
+        tsvdx->State = TS_VIDEO_SKIP;
+        return;
     }
+    // continuation without start code, keep the leading zeros
+    TsVideoEnqueue(stream, pts, dts, data + 9 + n, tsvdx->HeaderIndex - 9 - n);
+}
 
-#ifdef USE_PIP
-    if (stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
-        // SKIP PES header
-        VideoMpegEnqueue(stream, pts, dts, data + 9 + n, size - 9 - n);
-#ifndef USE_MPEG_COMPLETE
-        if (size < 65526) {
-            // mpeg codec supports incomplete packets
-            // waiting for a full complete packages, increases needed delays
-            // PES recordings sends incomplete packets
-            // incomplete packets  breaks the decoder for some stations
-            // for the new USE_PIP code, this is only a very little improvement
-            VideoNextPacket(stream, stream->CodecID);
-        }
+///
+/// Finish the current PES packet of the TS video demuxer.
+///
+/// @param stream   video stream
+/// @param tsvdx    transport stream video demuxer
+///
+static void TsVideoPesEnd(VideoStream * stream, TsVideoDemux * tsvdx)
+{
+    // pes packet ended, before probe was complete
+    if (tsvdx->State == TS_VIDEO_HEADER && tsvdx->HeaderIndex >= 9) {
+        TsVideoPesStart(stream, tsvdx);
+    }
+#ifndef USE_PIP
+    // mpeg codec supports incomplete packets, pes end is known here
+    if (tsvdx->State == TS_VIDEO_PAYLOAD && stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
+        VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
+    }
 #endif
-    } else {
-        // SKIP PES header
-        VideoEnqueue(stream, pts, dts, data + 9 + n, size - 9 - n);
+    // pes packet complete, don't wait for the next access unit
+    if (tsvdx->State == TS_VIDEO_PAYLOAD) {
+        VideoAccessUnitEnd(stream, NULL, 0, 1);
     }
-#else
+    tsvdx->State = TS_VIDEO_SKIP;
+}
 
-    // SKIP PES header
-    VideoEnqueue(stream, pts, dts, data + 9 + n, size - 9 - n);
+///
+/// Demux payload of one video TS packet.
+///
+/// @param stream   video stream
+/// @param tsvdx    transport stream video demuxer
+/// @param data payload of ts packet
+/// @param size size of payload
+/// @param is_start flag, start of pes packet
+///
+static void TsVideoParse(VideoStream * stream, TsVideoDemux * tsvdx, const uint8_t * data, int size, int is_start)
+{
+    if (is_start) {
+        TsVideoPesEnd(stream, tsvdx);
+        tsvdx->State = TS_VIDEO_HEADER;
+        tsvdx->HeaderIndex = 0;
+        tsvdx->HeaderSize = 9;
+        tsvdx->PesSize = -1;
+    }
 
-    // incomplete packets produce artefacts after channel switch
-    // packet < 65526 is the last split packet, detect it here for
-    // better latency
-    if (size < 65526 && stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
-        // mpeg codec supports incomplete packets
-        // waiting for a full complete packages, increases needed delays
-        VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
+    if (tsvdx->State == TS_VIDEO_HEADER) {
+        int n;
+
+        // collect pes header and the probe bytes
+        n = tsvdx->HeaderSize - tsvdx->HeaderIndex;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(tsvdx->Header + tsvdx->HeaderIndex, data, n);
+        tsvdx->HeaderIndex += n;
+        data += n;
+        size -= n;
+
+        if (tsvdx->HeaderIndex == 9 && tsvdx->HeaderSize == 9) {
+            const uint8_t *p;
+
+            p = tsvdx->Header;
+            // must be a video PES start code
+            if (p[0] || p[1] || p[2] != 0x01 || p[3] < PES_VIDEO_STREAM_S || p[3] > PES_VIDEO_STREAM_E) {
+                if (!stream->InvalidPesCounter++) {
+                    Error(_("[softhddev] invalid PES video packet\n"));
+                }
+                tsvdx->State = TS_VIDEO_SKIP;
+                return;
+            }
+            if (stream->InvalidPesCounter) {
+                if (stream->InvalidPesCounter > 1) {
+                    Error(_("[softhddev] %d invalid PES video packet(s)\n"), stream->InvalidPesCounter);
+                }
+                stream->InvalidPesCounter = 0;
+            }
+            if (p[4] || p[5]) {         // bounded pes packet
+                tsvdx->PesSize = (p[4] << 8 | p[5]) - 3;
+            }
+            tsvdx->HeaderSize = 9 + p[8] + TS_VIDEO_PROBE_SIZE;
+            // copy rest of header + probe
+            n = tsvdx->HeaderSize - tsvdx->HeaderIndex;
+            if (n > size) {
+                n = size;
+            }
+            memcpy(tsvdx->Header + tsvdx->HeaderIndex, data, n);
+            tsvdx->HeaderIndex += n;
+            data += n;
+            size -= n;
+        }
+        if (tsvdx->PesSize >= 0 && tsvdx->HeaderIndex - 9 >= tsvdx->PesSize) {
+            // short bounded packet, completely in header buffer
+            tsvdx->HeaderIndex = 9 + tsvdx->PesSize;
+            tsvdx->PesSize = 0;
+            TsVideoPesStart(stream, tsvdx);
+            TsVideoPesEnd(stream, tsvdx);
+            return;
+        }
+        if (tsvdx->HeaderIndex < tsvdx->HeaderSize) {
+            return;                     // need more bytes
+        }
+        if (tsvdx->PesSize >= 0) {
+            tsvdx->PesSize -= tsvdx->HeaderIndex - 9;
+        }
+        TsVideoPesStart(stream, tsvdx);
     }
-#endif
 
-    return size;
+    if (tsvdx->State == TS_VIDEO_PAYLOAD && size > 0) {
+        if (tsvdx->PesSize >= 0 && size > tsvdx->PesSize) {
+            size = tsvdx->PesSize;      // stuffing after bounded pes
+        }
+        TsVideoEnqueue(stream, AV_NOPTS_VALUE, AV_NOPTS_VALUE, data, size);
+        if (tsvdx->PesSize >= 0) {
+            tsvdx->PesSize -= size;
+            if (!tsvdx->PesSize) {
+                TsVideoPesEnd(stream, tsvdx);
+            }
+        }
+    }
 }
 
 /**
-**  Play video packet.
+**  Play transport stream video packet.
 **
-**  @param data data of exactly one complete PES packet
-**  @param size size of PES packet
-**
-**  @return number of bytes used, 0 if internal buffer are full.
+**  The TS payload is placed directly in the video packet ringbuffer,
+**  VDR's cTsToPes and the PES parsing of PlayVideo3 are bypassed.
 **
-**  @note vdr sends incomplete packets, va-api h264 decoder only
-**  supports complete packets.
-**  We buffer here until we receive an complete PES Packet, which
-**  is no problem, the audio is always far behind us.
-**  cTsToPes::GetPes splits the packets.
+**  @param data data of exactly one complete TS packet
+**  @param size size of TS packet (always TS_PACKET_SIZE)
 **
-**  @todo FIXME: combine the 5 ifs at start of the function
+**  @returns number of bytes consumed, 0 if internal buffer are full.
 */
-int PlayVideo(const uint8_t * data, int size)
+int PlayTsVideo(const uint8_t * data, int size)
 {
-    return PlayVideo3(MyVideoStream, data, size);
+    VideoStream *stream;
+    TsVideoDemux *tsvdx;
+    const uint8_t *p;
+
+    stream = MyVideoStream;
+    tsvdx = TsDemuxVideo;
+
+    if (!stream->Decoder) {             // no x11 video started
+        return size;
+    }
+    if (stream->SkipStream) {           // skip video stream
+        return size;
+    }
+    if (stream->Freezed) {              // stream freezed
+        return 0;
+    }
+    if (stream->NewStream) {            // channel switched
+        Debug(3, "video/ts: new stream %dms\n", GetMsTicks() - VideoSwitch);
+        if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 1) {
+            Debug(3, "video/ts: new video stream lost\n");
+            return 0;
+        }
+        VideoNextPacket(stream, AV_CODEC_ID_NONE);
+        stream->CodecID = AV_CODEC_ID_NONE;
+        stream->ClosingStream = 1;
+        stream->NewStream = 0;
+        stream->PesCut = 0;
+        stream->NoPesCut = 0;
+        stream->PesAligned = 0;
+        TsVideoReset(tsvdx);
+    }
+    // hard limit buffer full: needed for replay
+    if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 10 || VideoArenaFull(stream, size)) {
+        return 0;
+    }
+#ifdef USE_SOFTLIMIT
+    // soft limit buffer full
+    if (AudioSyncStream == stream && atomic_read(&stream->PacketsFilled) > 3
+        && AudioUsedBytes() > AUDIO_MIN_BUFFER_FREE * 2) {
+        return 0;
+    }
+#endif
+
+    p = data;
+    while (size >= TS_PACKET_SIZE) {
+        int pid;
+        int cc;
+        int payload;
+
+        if (p[0] != TS_PACKET_SYNC) {
+            Error(_("video/ts: transport stream out of sync\n"));
+            TsVideoReset(tsvdx);
+            return p - data + size;
+        }
+        if (p[1] & 0x80) {              // error indicator
+            Debug(3, "video/ts: transport error\n");
+            // payload damaged, drop the partial pes packet
+            VideoResetPacket(stream);
+            tsvdx->State = TS_VIDEO_SKIP;
+            goto next_packet;
+        }
+        pid = (p[1] & 0x1F) << 8 | p[2];
+        if (pid != tsvdx->Pid) {
+            if (tsvdx->Pid != -1) {
+                Debug(3, "video/ts: pid changed %#04x -> %#04x\n", tsvdx->Pid, pid);
+            }
+            TsVideoReset(tsvdx);
+            tsvdx->Pid = pid;
+        }
+        // skip adaptation field
+        switch (p[3] & 0x30) {          // adaption field
+            case 0x00:                 // reserved
+            case 0x20:                 // adaptation field only
+            default:
+                goto next_packet;
+            case 0x10:                 // only payload
+                payload = 4;
+                break;
+            case 0x30:                 // skip adapation field
+                payload = 5 + p[4];
+                // illegal length, ignore packet
+                if (payload >= TS_PACKET_SIZE) {
+                    Debug(3, "video/ts: illegal adaption field length\n");
+                    goto next_packet;
+                }
+                break;
+        }
+        // check continuity, only packets with payload count
+        cc = p[3] & 0x0F;
+        if (tsvdx->Continuity != -1 && ((tsvdx->Continuity + 1) & 0x0F) != cc) {
+            if (tsvdx->Continuity == cc) {  // duplicate packet
+                goto next_packet;
+            }
+            ++tsvdx->Discontinuities;
+            Debug(3, "video/ts: discontinuity %d -> %d\n", tsvdx->Continuity, cc);
+            // packet lost, drop the partial pes packet, also when skipping
+            // an access unit can continue over the lost packet
+            VideoResetPacket(stream);
+            tsvdx->State = TS_VIDEO_SKIP;
+        }
+        tsvdx->Continuity = cc;
+
+        TsVideoParse(stream, tsvdx, p + payload, TS_PACKET_SIZE - payload, p[1] & 0x40);
+
+      next_packet:
+        p += TS_PACKET_SIZE;
+        size -= TS_PACKET_SIZE;
+    }
+
+    return p - data;
 }
 
+#endif
+
 /// call VDR support function
 extern uint8_t *CreateJpeg(uint8_t *, int *, int, int, int);
 
@@ -2483,10 +4294,8 @@ int SetPlayMode(int play_mode)
                     // tell hw decoder we are closing stream
                     VideoSetClosing(MyVideoStream->HwDecoder);
                     VideoResetStart(MyVideoStream->HwDecoder);
-#ifdef DEBUG
                     VideoSwitch = GetMsTicks();
                     Debug(3, "video: new stream start\n");
-#endif
                 }
             }
             if (MyAudioDecoder) {       // tell audio parser we have new stream
@@ -2568,9 +4377,17 @@ void GetVideoSize(int *width, int *height, double *aspect)
 **  times.
 **
 **  @param speed    trick speed
+**  @param keyframes    fast forward/rewind, decode key pictures only
 */
-void TrickSpeed(int speed)
+void TrickSpeed(int speed, int keyframes)
 {
+    if (keyframes && !MyVideoStream->TrickKeyFrames) {
+        MyVideoStream->TrickDecoded = 0;
+        MyVideoStream->TrickSkipped = 0;
+        MyVideoStream->TrickFirstPTS = AV_NOPTS_VALUE;
+        MyVideoStream->TrickLastPTS = AV_NOPTS_VALUE;
+    }
+    MyVideoStream->TrickKeyFrames = speed && keyframes;
     MyVideoStream->TrickSpeed = speed;
     if (MyVideoStream->HwDecoder) {
         VideoSetTrickSpeed(MyVideoStream->HwDecoder, speed);
@@ -2590,8 +4407,13 @@ void Clear(void)
     int i;
 
     VideoResetPacket(MyVideoStream);    // terminate work
+#ifdef USE_TS_VIDEO
+    TsVideoReset(TsDemuxVideo);
+#endif
     MyVideoStream->ClearBuffers = 1;
+    VideoDisplayWakeup();               // decoder handles the clear
     if (!SkipAudio) {
+        AudioQueueClear();
         AudioFlushBuffers();
         //NewAudioStream = 1;
     }
@@ -2610,7 +4432,7 @@ void Clear(void)
 */
 void Play(void)
 {
-    TrickSpeed(0);                      // normal play
+    TrickSpeed(0, 0);                   // normal play
     SkipAudio = 0;
     AudioPlay();
 }
@@ -2631,10 +4453,45 @@ void Freeze(void)
 void Mute(void)
 {
     SkipAudio = 1;
+    AudioQueueClear();
     AudioFlushBuffers();
     //AudioSetVolume(0);
 }
 
+/**
+**  Find the end of an unbounded video PES packet.
+**
+**  VDR pes recordings can contain video PES packets without length,
+**  followed by more PES packets.  Stream ids >= 0xB9 (system start codes)
+**  can't be part of the MPEG-2/H264/HEVC elementary stream.
+**
+**  @param data pes packet data
+**  @param size number of bytes in buffer
+**
+**  @returns length of the PES packet (without start code), 0 if unknown.
+*/
+static int StillPictureNextPes(const uint8_t * data, int size)
+{
+    int i;
+    int o;
+
+    // skip pes header
+    if (size < 9 || (i = 9 + data[8]) >= size) {
+        return 0;
+    }
+    while ((o = StartCodeFind(data + i, size - i)) >= 0) {
+        i += o;
+        if (i + 3 >= size) {
+            break;
+        }
+        if (data[i + 3] >= 0xB9) {
+            return i - 6;
+        }
+        i += 3;
+    }
+    return 0;
+}
+
 /**
 **  Display the given I-frame as a still picture.
 **
@@ -2696,6 +4553,9 @@ void StillPicture(const uint8_t * data, int size)
 #endif
 
                 len = (split[4] << 8) + split[5];
+                if (!len) {             // unbounded, search next pes start
+                    len = StillPictureNextPes(split, n);
+                }
                 if (!len || len + 6 > n) {
                     if ((split[3] & 0xF0) == 0xE0) {
                         // video only
@@ -2773,7 +4633,8 @@ int Poll(int timeout)
         filled = atomic_read(&MyVideoStream->PacketsFilled);
         // soft limit + hard limit
         full = (used > AUDIO_MIN_BUFFER_FREE && filled > 3)
-            || AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE || filled >= VIDEO_PACKET_MAX - 10;
+            || AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE || filled >= VIDEO_PACKET_MAX - 10
+            || VideoArenaFull(MyVideoStream, 0);
 
         if (!full || !timeout) {
             return !full;
@@ -2875,7 +4736,9 @@ const char *CommandLineHelp(void)
         "  -g geometry\tx11 window geometry wxh+x+y\n" 
 		"  -r Refresh\tRefreshrate for DRM (default is 50 Hz)\n"
 		"  -C Connector\tConnector for DRM (default is current Connector)\n"
-		"  -v device\tvideo driver device (cuvid)\n"
+		"  -v device\tvideo driver device (cuvid, soft)\n"
+        "  -b MiB\tvideo packet buffer size (default 64 MiB)\n"
+        "  -t threads\tsoftware video decoder threads (default 0 = all cpus)\n"
         "  -s\t\tstart in suspended mode\n" "  -x\t\tstart x11 server, with -xx try to connect, if this fails\n"
         "  -X args\tX11 server arguments (f.e. -nocursor)\n" "  -w workaround\tenable/disable workarounds\n"
         "\tno-hw-decoder\t\tdisable hw decoder, use software decoder only\n"
@@ -2884,6 +4747,7 @@ const char *CommandLineHelp(void)
         "\tstill-h264-hw-decoder\tenable h264 hw decoder for still-pictures\n"
         "\talsa-driver-broken\tdisable broken alsa driver message\n"
         "\talsa-no-close-open\tdisable close open to fix alsa no sound bug\n"
+        "\t\t\t\tand keep pcm open, if the audio format is unchanged\n"
         "\talsa-close-open-delay\tenable close open delay to fix no sound bug\n"
         "\tignore-repeat-pict\tdisable repeat pict message\n"
         "\tuse-possible-defect-frames prefer faster channel switch\n" "  -D\t\tstart in detached mode\n";
@@ -2908,10 +4772,17 @@ int ProcessArgs(int argc, char *const argv[])
 #endif
 
     for (;;) {
-        switch (getopt(argc, argv, "-a:c:C:r:d:fg:p:sv:w:xDX:")) {
+        switch (getopt(argc, argv, "-a:b:c:C:r:d:fg:p:st:v:w:xDX:")) {
             case 'a':                  // audio device for pcm
                 AudioSetDevice(optarg);
                 continue;
+            case 'b':                  // video packet buffer size
+                ConfigVideoPacketBuffer = atoi(optarg);
+                if (ConfigVideoPacketBuffer < 4 || ConfigVideoPacketBuffer > 1024) {
+                    fprintf(stderr, _("Video packet buffer size must be 4 - 1024 MiB\n"));
+                    return 0;
+                }
+                continue;
             case 'c':                  // channel of audio mixer
                 AudioSetChannel(optarg);
                 continue;
@@ -2952,6 +4823,13 @@ int ProcessArgs(int argc, char *const argv[])
             case 'D':                  // start in detached mode
                 ConfigStartSuspended = -1;
                 continue;
+            case 't':                  // software video decoder threads
+                CodecVideoThreads = atoi(optarg);
+                if (CodecVideoThreads < 0 || CodecVideoThreads > 64) {
+                    fprintf(stderr, _("Video decoder threads must be 0 - 64\n"));
+                    return 0;
+                }
+                continue;
             case 'w':                  // workarounds
                 if (!strcasecmp("no-hw-decoder", optarg)) {
                     VideoHardwareDecoder = 0;
@@ -3119,6 +4997,7 @@ void SoftHdDeviceExit(void)
 {
     // lets hope that vdr does a good thread cleanup
 
+    AudioDecodeStop();
     AudioExit();
     if (MyAudioDecoder) {
         CodecAudioClose(MyAudioDecoder);
@@ -3127,6 +5006,9 @@ void SoftHdDeviceExit(void)
     }
     NewAudioStream = 0;
     av_packet_unref(AudioAvPkt);
+#ifndef NO_TS_AUDIO
+    PesExit(PesDemuxAudio);
+#endif
 
     StopVideo();
 
@@ -3185,12 +5067,15 @@ int Start(void)
         StartXServer();
     }
     CodecInit();
+    StartCodeInit();
+    Debug(3, "[softhddev] %s start code scanner\n", StartCodeName());
 
     pthread_mutex_init(&MyVideoStream->DecoderLockMutex, NULL);
 #ifdef USE_PIP
     pthread_mutex_init(&PipVideoStream->DecoderLockMutex, NULL);
 #endif
     pthread_mutex_init(&SuspendLockMutex, NULL);
+    AudioDecodeStart();
 
     if (!ConfigStartSuspended) {
         // FIXME: AudioInit for HDMI after X11 startup
@@ -3211,6 +5096,9 @@ int Start(void)
 
 #ifndef NO_TS_AUDIO
     PesInit(PesDemuxAudio);
+#endif
+#ifdef USE_TS_VIDEO
+    TsVideoReset(TsDemuxVideo);
 #endif
     Info(_("[softhddev] ready%s\n"),
         ConfigStartSuspended ? ConfigStartSuspended == -1 ? " detached" : " suspended" : "");
@@ -3228,6 +5116,10 @@ void Stop(void)
 #ifdef DEBUG
     Debug(3, "video: max used PES packet size: %d\n", VideoMaxPacketSize);
 #endif
+#ifndef NO_TS_AUDIO
+    Info(_("pesdemux: %" PRIu64 " bytes copied, %" PRIu64 " moved, %" PRIu64 " decoded, %d resyncs\n"),
+        PesDemuxAudio->BytesCopied, PesDemuxAudio->BytesMoved, PesDemuxAudio->BytesDecoded, PesDemuxAudio->Resyncs);
+#endif
 }
 
 /**
@@ -3308,6 +5200,7 @@ void Suspend(int video, int audio, int dox11)
     SkipAudio = 1;
 
     if (audio) {
+        AudioQueueClear();
         AudioExit();
         if (MyAudioDecoder) {
             CodecAudioClose(MyAudioDecoder);
@@ -3382,6 +5275,62 @@ void GetStats(int *missed, int *duped, int *dropped, int *counter, float *framet
     }
 }
 
+/**
+**  Get trick speed statistics.
+**
+**  @param[out] decoded pictures decoded at fast forward/rewind
+**  @param[out] skipped pictures skipped at fast forward/rewind
+**  @param[out] fps decoded pictures per second of content
+*/
+void GetTrickStats(int *decoded, int *skipped, float *fps)
+{
+    int64_t first;
+    int64_t last;
+
+    *decoded = MyVideoStream->TrickDecoded;
+    *skipped = MyVideoStream->TrickSkipped;
+    *fps = 0.0f;
+    first = MyVideoStream->TrickFirstPTS;
+    last = MyVideoStream->TrickLastPTS;
+    if (first != (int64_t) AV_NOPTS_VALUE && last != (int64_t) AV_NOPTS_VALUE && first != last) {
+        // rewind runs backwards
+        *fps = ((*decoded - 1) * 90000.0f) / llabs(last - first);
+    }
+}
+
+/**
+**  Get audio enqueue latency statistics.
+**
+**  Time VDR spends in PlayAudio and PlayTsAudio, since start.
+**
+**  @param[out] p50     median latency in us
+**  @param[out] p90     90th percentile latency in us
+**  @param[out] p99     99th percentile latency in us
+**  @param[out] max     biggest latency in us
+**
+**  @returns number of measured packets.
+*/
+int GetAudioLatencyStats(int *p50, int *p90, int *p99, int *max)
+{
+    *p50 = AudioLatencyPercentile(AudioEnqueueLatency, 50);
+    *p90 = AudioLatencyPercentile(AudioEnqueueLatency, 90);
+    *p99 = AudioLatencyPercentile(AudioEnqueueLatency, 99);
+    *max = AudioEnqueueLatency->Max;
+    return AudioEnqueueLatency->Samples;
+}
+
+/**
+**  Get overload discard statistics of the current stream.
+**
+**  @param[out] nonref  pictures discarded at non-reference level
+**  @param[out] bidir   pictures discarded at bidirectional level
+*/
+void GetDiscardStats(int *nonref, int *bidir)
+{
+    *nonref = MyVideoStream->Discarded[0];
+    *bidir = MyVideoStream->Discarded[1];
+}
+
 /**
 **  Scale the currently shown video.
 **
@@ -3466,6 +5415,7 @@ void PipStop(void)
     ScaleVideo(0, 0, 0, 0);
 
     PipVideoStream->Close = 1;
+    VideoDisplayWakeup();
     for (i = 0; PipVideoStream->Close && i < 50; ++i) {
         usleep(1 * 1000);
     }
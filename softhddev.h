@@ -43,11 +43,13 @@ extern "C"
     extern void SetVolumeDevice(int);
     /// C plugin reset channel id (restarts audio)
     extern void ResetChannelId(void);
+    /// C plugin set vdr channel id of live video
+    extern void SetVideoChannelId(const char *);
 
     /// C plugin play video packet
     extern int PlayVideo(const uint8_t *, int);
     /// C plugin play TS video packet
-    extern void PlayTsVideo(const uint8_t *, int);
+    extern int PlayTsVideo(const uint8_t *, int);
     /// C plugin grab an image
     extern uint8_t *GrabImage(int *, int, int, int, int);
 
@@ -58,7 +60,7 @@ extern "C"
     /// C plugin get video stream size and aspect
     extern void GetVideoSize(int *, int *, double *);
     /// C plugin set trick speed
-    extern void TrickSpeed(int);
+    extern void TrickSpeed(int, int);
     /// C plugin clears all video and audio data from the device
     extern void Clear(void);
     /// C plugin sets the device into play mode
@@ -97,6 +99,12 @@ extern "C"
 
     /// Get decoder statistics
     extern void GetStats(int *, int *, int *, int *, float *);
+    /// Get trick speed statistics
+    extern void GetTrickStats(int *, int *, float *);
+    /// Get overload discard statistics
+    extern void GetDiscardStats(int *, int *);
+    /// Get audio enqueue latency statistics
+    extern int GetAudioLatencyStats(int *, int *, int *, int *);
     /// C plugin scale video
     extern void ScaleVideo(int, int, int, int);
 
@@ -0,0 +1,549 @@
+///
+/// @file startcode.c	@brief Start code scanner module
+///
+/// Contributor(s):
+///
+/// License: AGPLv3
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Affero General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU Affero General Public License for more details.
+//////////////////////////////////////////////////////////////////////////////
+
+///
+/// @defgroup StartCode The start code scanner module.
+///
+/// Finds the 0x00 0x00 0x01 start code prefix of PES, MPEG-2, H264 and
+/// HEVC streams.  The scanner is selected at runtime, depending on the
+/// features of the cpu (AVX2, SSE2, NEON or plain C).
+///
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_STARTCODE_X86               ///< build SSE2 + AVX2 scanner
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define USE_STARTCODE_NEON              ///< build NEON scanner
+#include <arm_neon.h>
+#endif
+
+#include "startcode.h"
+
+//----------------------------------------------------------------------------
+//  C
+//----------------------------------------------------------------------------
+
+/**
+**	Find start code prefix, generic C version.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns offset of the first 0x00 of the prefix, -1 if not found.
+*/
+static int StartCodeFindC(const uint8_t * data, int size)
+{
+    int i;
+
+    // check the third byte, skip 3 bytes when it can't be part of a prefix
+    i = 2;
+    while (i < size) {
+        if (data[i] > 1) {
+            i += 3;
+        } else if (data[i] == 1 && !data[i - 1] && !data[i - 2]) {
+            return i - 2;
+        } else {
+            ++i;
+        }
+    }
+    return -1;
+}
+
+/**
+**	Count leading zero bytes, generic C version.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns number of leading zero bytes.
+*/
+static int StartCodeZerosC(const uint8_t * data, int size)
+{
+    int i;
+
+    for (i = 0; i < size && !data[i]; ++i) {
+    }
+    return i;
+}
+
+#ifdef USE_STARTCODE_X86
+
+//----------------------------------------------------------------------------
+//  SSE2
+//----------------------------------------------------------------------------
+
+/**
+**	Find start code prefix, SSE2 version.
+**
+**	Two overlapping loads find all 0x00 0x00 pairs of 16 positions,
+**	only the candidates are checked for the 0x01.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns offset of the first 0x00 of the prefix, -1 if not found.
+*/
+static __attribute__ ((target("sse2")))
+int StartCodeFindSse2(const uint8_t * data, int size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i + 18 <= size; i += 16) {
+        __m128i a;
+        __m128i b;
+        unsigned mask;
+
+        a = _mm_loadu_si128((const __m128i *)(data + i));
+        b = _mm_loadu_si128((const __m128i *)(data + i + 1));
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, zero))
+            & _mm_movemask_epi8(_mm_cmpeq_epi8(b, zero));
+        while (mask) {
+            int j;
+
+            j = __builtin_ctz(mask);
+            if (data[i + j + 2] == 0x01) {
+                return i + j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    // tail
+    if ((size = StartCodeFindC(data + i, size - i)) < 0) {
+        return -1;
+    }
+    return i + size;
+}
+
+/**
+**	Count leading zero bytes, SSE2 version.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns number of leading zero bytes.
+*/
+static __attribute__ ((target("sse2")))
+int StartCodeZerosSse2(const uint8_t * data, int size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i + 16 <= size; i += 16) {
+        unsigned mask;
+
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), zero));
+        if (mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + StartCodeZerosC(data + i, size - i);
+}
+
+//----------------------------------------------------------------------------
+//  AVX2
+//----------------------------------------------------------------------------
+
+/**
+**	Find start code prefix, AVX2 version.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns offset of the first 0x00 of the prefix, -1 if not found.
+*/
+static __attribute__ ((target("avx2")))
+int StartCodeFindAvx2(const uint8_t * data, int size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i + 34 <= size; i += 32) {
+        __m256i a;
+        __m256i b;
+        unsigned mask;
+
+        a = _mm256_loadu_si256((const __m256i *)(data + i));
+        b = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, zero))
+            & _mm256_movemask_epi8(_mm256_cmpeq_epi8(b, zero));
+        while (mask) {
+            int j;
+
+            j = __builtin_ctz(mask);
+            if (data[i + j + 2] == 0x01) {
+                return i + j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    // tail
+    if ((size = StartCodeFindC(data + i, size - i)) < 0) {
+        return -1;
+    }
+    return i + size;
+}
+
+/**
+**	Count leading zero bytes, AVX2 version.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns number of leading zero bytes.
+*/
+static __attribute__ ((target("avx2")))
+int StartCodeZerosAvx2(const uint8_t * data, int size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i + 32 <= size; i += 32) {
+        unsigned mask;
+
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i)), zero));
+        if (mask != 0xFFFFFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + StartCodeZerosC(data + i, size - i);
+}
+
+#endif
+
+#ifdef USE_STARTCODE_NEON
+
+//----------------------------------------------------------------------------
+//  NEON
+//----------------------------------------------------------------------------
+
+/**
+**	Find start code prefix, NEON version.
+**
+**	Blocks of 16 bytes without a zero byte can't contain the start of
+**	a prefix and are skipped, the other blocks are checked in C.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns offset of the first 0x00 of the prefix, -1 if not found.
+*/
+static int StartCodeFindNeon(const uint8_t * data, int size)
+{
+    int i;
+
+    for (i = 0; i + 18 <= size; i += 16) {
+        uint8x16_t a;
+        uint8x16_t b;
+        int j;
+
+        a = vceqzq_u8(vld1q_u8(data + i));
+        b = vceqzq_u8(vld1q_u8(data + i + 1));
+        if (!vmaxvq_u8(vandq_u8(a, b))) {
+            continue;                   // no 0x00 0x00 pair
+        }
+        for (j = 0; j < 16; ++j) {
+            if (!data[i + j] && !data[i + j + 1] && data[i + j + 2] == 0x01) {
+                return i + j;
+            }
+        }
+    }
+    // tail
+    if ((size = StartCodeFindC(data + i, size - i)) < 0) {
+        return -1;
+    }
+    return i + size;
+}
+
+/**
+**	Count leading zero bytes, NEON version.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns number of leading zero bytes.
+*/
+static int StartCodeZerosNeon(const uint8_t * data, int size)
+{
+    int i;
+
+    for (i = 0; i + 16 <= size; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(data + i))) {
+            break;                      // non zero byte in block
+        }
+    }
+    return i + StartCodeZerosC(data + i, size - i);
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+//  Dispatch
+//----------------------------------------------------------------------------
+
+    /// Start code scanner function table.
+typedef struct _start_code_scanner_
+{
+    const char *Name;                   ///< scanner name
+    int (*const Find) (const uint8_t *, int);   ///< find prefix
+    int (*const Zeros) (const uint8_t *, int);  ///< count leading zeros
+} StartCodeScanner;
+
+    /// Generic C scanner
+static const StartCodeScanner StartCodeScannerC = {
+    .Name = "C",
+    .Find = StartCodeFindC,
+    .Zeros = StartCodeZerosC,
+};
+
+#ifdef USE_STARTCODE_X86
+
+    /// SSE2 scanner
+static const StartCodeScanner StartCodeScannerSse2 = {
+    .Name = "SSE2",
+    .Find = StartCodeFindSse2,
+    .Zeros = StartCodeZerosSse2,
+};
+
+    /// AVX2 scanner
+static const StartCodeScanner StartCodeScannerAvx2 = {
+    .Name = "AVX2",
+    .Find = StartCodeFindAvx2,
+    .Zeros = StartCodeZerosAvx2,
+};
+
+#endif
+
+#ifdef USE_STARTCODE_NEON
+
+    /// NEON scanner
+static const StartCodeScanner StartCodeScannerNeon = {
+    .Name = "NEON",
+    .Find = StartCodeFindNeon,
+    .Zeros = StartCodeZerosNeon,
+};
+
+#endif
+
+    /// Selected start code scanner, C until StartCodeInit is called.
+static const StartCodeScanner *StartCodeUsedScanner = &StartCodeScannerC;
+
+/**
+**	Select the fastest start code scanner supported by the cpu.
+*/
+void StartCodeInit(void)
+{
+    StartCodeUsedScanner = &StartCodeScannerC;
+#ifdef USE_STARTCODE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        StartCodeUsedScanner = &StartCodeScannerAvx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        StartCodeUsedScanner = &StartCodeScannerSse2;
+    }
+#endif
+#ifdef USE_STARTCODE_NEON
+    StartCodeUsedScanner = &StartCodeScannerNeon;
+#endif
+}
+
+/**
+**	Get name of the selected start code scanner.
+*/
+const char *StartCodeName(void)
+{
+    return StartCodeUsedScanner->Name;
+}
+
+/**
+**	Find next 0x00 0x00 0x01 start code prefix.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns offset of the first 0x00 of the prefix, -1 if not found.
+*/
+int StartCodeFind(const uint8_t * data, int size)
+{
+    return StartCodeUsedScanner->Find(data, size);
+}
+
+/**
+**	Count leading zero bytes.
+**
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns number of leading zero bytes, @a size if all are zero.
+*/
+int StartCodeZeros(const uint8_t * data, int size)
+{
+    return StartCodeUsedScanner->Zeros(data, size);
+}
+
+#ifdef STARTCODE_TEST
+
+//----------------------------------------------------------------------------
+//  Test + Benchmark
+//----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <time.h>
+
+/**
+**	Get monotonic time in seconds.
+*/
+static double StartCodeTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+**	Scan the whole buffer, like the demuxer does.
+**
+**	@param scanner	scanner to use
+**	@param data	buffer to scan
+**	@param size	number of bytes in buffer
+**
+**	@returns number of start codes found.
+*/
+static int StartCodeCount(const StartCodeScanner * scanner, const uint8_t * data, int size)
+{
+    int n;
+    int o;
+
+    n = 0;
+    while ((o = scanner->Find(data, size)) >= 0) {
+        ++n;
+        data += o + 3;
+        size -= o + 3;
+    }
+    return n;
+}
+
+/**
+**	Main entry point.
+**
+**	startcode_test [file] [loops]
+**
+**	Scans a captured stream (fe. a TS/PES UHD recording) with all
+**	scanners supported by the cpu and prints the throughput in GB/s.
+**	Without file random data with some start codes is used.
+*/
+int main(int argc, char *const argv[])
+{
+    const StartCodeScanner *scanners[4];
+    uint8_t *data;
+    long size;
+    int loops;
+    int n;
+    int i;
+
+    size = 64 * 1024 * 1024;
+    loops = argc > 2 ? atoi(argv[2]) : 10;
+    if (argc > 1) {
+        FILE *f;
+
+        if (!(f = fopen(argv[1], "rb"))) {
+            perror(argv[1]);
+            return -1;
+        }
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (size <= 0 || size > INT32_MAX || !(data = malloc(size))) {
+            fprintf(stderr, "%s: can't load file\n", argv[1]);
+            fclose(f);
+            return -1;
+        }
+        if (fread(data, 1, size, f) != (size_t) size) {
+            perror(argv[1]);
+            fclose(f);
+            return -1;
+        }
+        fclose(f);
+    } else {
+        if (!(data = malloc(size))) {
+            return -1;
+        }
+        for (i = 0; i < size; ++i) {
+            data[i] = random();
+        }
+        // a start code every ~4k, like a slice structure
+        for (i = 0; i + 3 < size; i += 4000 + (random() & 0xFF)) {
+            data[i] = 0x00;
+            data[i + 1] = 0x00;
+            data[i + 2] = 0x01;
+        }
+    }
+
+    StartCodeInit();
+    printf("startcode_test: selected scanner %s, %ld bytes, %d loops\n", StartCodeName(), size, loops);
+
+    n = 0;
+    scanners[n++] = &StartCodeScannerC;
+#ifdef USE_STARTCODE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        scanners[n++] = &StartCodeScannerSse2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        scanners[n++] = &StartCodeScannerAvx2;
+    }
+#endif
+#ifdef USE_STARTCODE_NEON
+    scanners[n++] = &StartCodeScannerNeon;
+#endif
+
+    for (i = 0; i < n; ++i) {
+        double start;
+        double elapsed;
+        int found;
+        int zeros;
+        int l;
+
+        found = 0;
+        start = StartCodeTime();
+        for (l = 0; l < loops; ++l) {
+            found = StartCodeCount(scanners[i], data, size);
+        }
+        elapsed = StartCodeTime() - start;
+        zeros = scanners[i]->Zeros(data, size);
+
+        printf("%-5s %8d start codes %6d zeros %7.2f GB/s\n", scanners[i]->Name, found, zeros,
+            elapsed > 0 ? (double)size * loops / elapsed / 1e9 : 0.0);
+        if (found != StartCodeCount(&StartCodeScannerC, data, size)
+            || zeros != StartCodeZerosC(data, size)) {
+            fprintf(stderr, "startcode_test: %s differs from C scanner\n", scanners[i]->Name);
+            return -1;
+        }
+    }
+    free(data);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,36 @@
+///
+/// @file startcode.h	@brief Start code scanner module header file
+///
+/// Contributor(s):
+///
+/// License: AGPLv3
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Affero General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU Affero General Public License for more details.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+/// @addtogroup StartCode
+/// @{
+
+/// select the fastest scanner for this cpu
+extern void StartCodeInit(void);
+
+/// name of the selected scanner
+extern const char *StartCodeName(void);
+
+/// find next 0x00 0x00 0x01 start code prefix
+extern int StartCodeFind(const uint8_t *, int);
+
+/// count leading zero bytes
+extern int StartCodeZeros(const uint8_t *, int);
+
+/// @}
@@ -294,6 +294,7 @@ typedef struct _video_module_
     void (*const SetTrickSpeed)(const VideoHwDecoder *, int);
     uint8_t *(*const GrabOutput)(int *, int *, int *, int);
     void (*const GetStats)(VideoHwDecoder *, int *, int *, int *, int *, float *);
+    int (*const GetAVDiff)(const VideoHwDecoder *);
     void (*const SetBackground)(uint32_t);
     void (*const SetVideoMode)(void);
 
@@ -366,6 +367,8 @@ static unsigned VideoWindowWidth;       ///< video output window width
 static unsigned VideoWindowHeight;      ///< video output window height
 
 static const VideoModule NoopModule;    ///< forward definition of noop module
+static const VideoModule SoftModule;    ///< forward definition of soft module
+static char VideoSoftDecode;            ///< flag software decoder module used
 
 /// selected video module
 static const VideoModule *VideoUsedModule = &NoopModule;
@@ -425,6 +428,9 @@ static int DRMRefresh = 50;
 static char Video60HzMode;              ///< handle 60hz displays
 static char VideoSoftStartSync;         ///< soft start sync audio/video
 static const int VideoSoftStartFrames = 100;    ///< soft start frames
+static char VideoMasterSync;            ///< audio follows the video clock
+static volatile int VideoMasterDiff;    ///< last video - audio difference
+static volatile uint32_t VideoMasterTick;   ///< time of last difference
 static char VideoShowBlackPicture;      ///< flag show black picture
 
 static float VideoBrightness = 0.0f;
@@ -442,9 +448,11 @@ static xcb_atom_t NetWmState;           ///< wm-state message atom
 static xcb_atom_t NetWmStateFullscreen; ///< fullscreen wm-state message atom
 static xcb_atom_t NetWmStateAbove;
 
-#ifdef DEBUG
 extern uint32_t VideoSwitch;            ///< ticks for channel switch
-#endif
+static uint32_t VideoSwitchSeen;        ///< last channel switch seen by decoder
+static volatile uint32_t VideoZapStart; ///< channel switch waiting for first frame
+static int VideoZapCount;               ///< number of measured channel switches
+static uint32_t VideoZapTotal;          ///< sum of channel switch times
 extern void AudioVideoReady(int64_t);   ///< tell audio video is ready
 
 #ifdef USE_VIDEO_THREAD
@@ -454,6 +462,17 @@ static pthread_cond_t VideoWakeupCond;  ///< wakeup condition variable
 static pthread_mutex_t VideoMutex;      ///< video condition mutex
 static pthread_mutex_t VideoLockMutex;  ///< video lock mutex
 pthread_mutex_t OSDMutex;               ///< OSD update mutex
+
+static char VideoDecoderEvent;          ///< pending event for decode thread
+static uint64_t VideoDecoderEventTime;  ///< us time of first pending packet
+static int VideoDecoderWakeups;         ///< decode thread wakeups
+static int VideoDecoderLatencies;       ///< number of measured latencies
+static uint64_t VideoDecoderLatencySum; ///< sum of decode start latencies
+static uint32_t VideoDecoderLatencyMax; ///< max decode start latency
+static uint64_t VideoDecoderReportTime; ///< us time of last statistic
+static int VideoDecoderWakeupRate;      ///< last statistic wakeups/s
+static int VideoDecoderLatencyAvg;      ///< last statistic avg. latency in us
+static int VideoDecoderLatencyPeak;     ///< last statistic max. latency in us
 #endif
 
 static pthread_t VideoDisplayThread;    ///< video display thread
@@ -529,6 +548,7 @@ static int OsdIndex = 0;                ///< index into OsdGlTextures
 void VideoThreadLock(void);             ///< lock video thread
 void VideoThreadUnlock(void);           ///< unlock video thread
 static void VideoThreadExit(void);      ///< exit/kill video thread
+static void VideoDecoderSignal(int);    ///< wakeup video decode thread
 
 #ifdef USE_SCREENSAVER
 static void X11SuspendScreenSaver(xcb_connection_t *, int);
@@ -1267,6 +1287,91 @@ static VideoResolutions VideoResolutionGroup(int width, int height, __attribute_
     return VideoResolution1080i;
 }
 
+//----------------------------------------------------------------------------
+//  Frame pool
+//----------------------------------------------------------------------------
+
+#define VIDEO_FRAME_POOL ((CODEC_SURFACES_MAX + 1) * 2)  ///< frames for all surfaces of two decoders
+
+static AVFrame *VideoFramePool[VIDEO_FRAME_POOL];   ///< free frames
+static int VideoFramePoolN;             ///< number of free frames
+static int VideoFramePoolMisses;        ///< frames allocated, pool empty
+static pthread_mutex_t VideoFramePoolMutex; ///< lock for frame pool
+
+///
+/// Initialize the frame pool.
+///
+static void VideoFramePoolInit(void)
+{
+    pthread_mutex_init(&VideoFramePoolMutex, NULL);
+    for (VideoFramePoolN = 0; VideoFramePoolN < VIDEO_FRAME_POOL; ++VideoFramePoolN) {
+        if (!(VideoFramePool[VideoFramePoolN] = av_frame_alloc())) {
+            break;
+        }
+    }
+    VideoFramePoolMisses = 0;
+}
+
+///
+/// Cleanup the frame pool.
+///
+static void VideoFramePoolExit(void)
+{
+    while (VideoFramePoolN > 0) {
+        av_frame_free(&VideoFramePool[--VideoFramePoolN]);
+    }
+    pthread_mutex_destroy(&VideoFramePoolMutex);
+}
+
+///
+/// Get a frame from the pool for the decoder.
+///
+/// The frame is owned by the caller until it is handed to the render
+/// function, the renderer gives it back with VideoFrameRelease.
+///
+/// @returns empty frame, NULL if out of memory.
+///
+AVFrame *VideoFrameGet(void)
+{
+    AVFrame *frame;
+
+    pthread_mutex_lock(&VideoFramePoolMutex);
+    if (VideoFramePoolN) {
+        frame = VideoFramePool[--VideoFramePoolN];
+        pthread_mutex_unlock(&VideoFramePoolMutex);
+        return frame;
+    }
+    ++VideoFramePoolMisses;
+    pthread_mutex_unlock(&VideoFramePoolMutex);
+
+    return av_frame_alloc();
+}
+
+///
+/// Give a frame back to the pool.
+///
+/// The frame data references are dropped, the frame itself is kept
+/// for the next decode.
+///
+/// @param[in,out] frame    frame to release, set to NULL
+///
+void VideoFrameRelease(AVFrame ** frame)
+{
+    if (!*frame) {
+        return;
+    }
+    av_frame_unref(*frame);
+
+    pthread_mutex_lock(&VideoFramePoolMutex);
+    if (VideoFramePoolN < VIDEO_FRAME_POOL) {
+        VideoFramePool[VideoFramePoolN++] = *frame;
+        *frame = NULL;
+    }
+    pthread_mutex_unlock(&VideoFramePoolMutex);
+
+    av_frame_free(frame);               // pool full
+}
+
 //----------------------------------------------------------------------------
 //  CUVID
 //----------------------------------------------------------------------------
@@ -1350,6 +1455,8 @@ typedef struct _cuvid_decoder_
     int SurfaceRead;                    ///< read pointer
     atomic_t SurfacesFilled;            ///< how many of the buffer is used
     AVFrame *frames[CODEC_SURFACES_MAX + 1];
+    uint8_t *SoftBuffer;                ///< software frame upload buffer
+    int SoftBufferSize;                 ///< size of software upload buffer
 #ifdef CUVID
     CUarray cu_array[CODEC_SURFACES_MAX + 1][2];
     CUgraphicsResource cu_res[CODEC_SURFACES_MAX + 1][2];
@@ -1549,14 +1656,15 @@ static void CuvidDestroySurfaces(CuvidDecoder * decoder)
 #endif
     for (i = 0; i < decoder->SurfacesNeeded; i++) {
         if (decoder->frames[i]) {
-            av_frame_free(&decoder->frames[i]);
+            VideoFrameRelease(&decoder->frames[i]);
         }
         for (j = 0; j < 2; j++) {
 #ifdef PLACEBO
             if (decoder->pl_images[i].planes[j].texture) {
 
 #ifdef VAAPI
-                if (p->has_dma_buf && decoder->pl_images[i].planes[j].texture->params.shared_mem.handle.fd) {
+                if (p->has_dma_buf && !VideoSoftDecode
+                    && decoder->pl_images[i].planes[j].texture->params.shared_mem.handle.fd) {
                     close(decoder->pl_images[i].planes[j].texture->params.shared_mem.handle.fd);
                 }
 #endif
@@ -1564,7 +1672,9 @@ static void CuvidDestroySurfaces(CuvidDecoder * decoder)
             }
 #else
 #ifdef CUVID
-            checkCudaErrors(cuGraphicsUnregisterResource(decoder->cu_res[i][j]));
+            if (!VideoSoftDecode) {
+                checkCudaErrors(cuGraphicsUnregisterResource(decoder->cu_res[i][j]));
+            }
 #endif
 #ifdef VAAPI
             if (decoder->images[i * 2 + j]) {
@@ -1647,10 +1757,10 @@ static void CuvidReleaseSurface(CuvidDecoder * decoder, int surface)
     int i;
 
     if (decoder->frames[surface]) {
-        av_frame_free(&decoder->frames[surface]);
+        VideoFrameRelease(&decoder->frames[surface]);
     }
 #ifdef PLACEBO
-    if (p->has_dma_buf) {
+    if (p->has_dma_buf && !VideoSoftDecode) {
         if (decoder->pl_images[surface].planes[0].texture) {
             if (decoder->pl_images[surface].planes[0].texture->params.shared_mem.handle.fd) {
                 close(decoder->pl_images[surface].planes[0].texture->params.shared_mem.handle.fd);
@@ -1941,26 +2051,30 @@ static CuvidDecoder *CuvidNewHwDecoder(VideoStream * stream)
         Error(_("video/cuvid: out of decoders\n"));
         return NULL;
     }
+    if (!VideoSoftDecode) {             // software decoder needs no hw device
 #ifdef CUVID
-    if ((i = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_CUDA, X11DisplayName, NULL, 0)) != 0) {
-        Fatal("codec: can't allocate HW video codec context err %04x", i);
-    }
+        if ((i = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_CUDA, X11DisplayName, NULL, 0)) != 0) {
+            Fatal("codec: can't allocate HW video codec context err %04x", i);
+        }
 #endif
 #ifdef VAAPI
-    // if ((i = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI, ":0.0" , NULL, 0)) != 0 ) {
-    if ((i = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI, "/dev/dri/renderD128", NULL, 0)) != 0) {
-        Fatal("codec: can't allocate HW video codec context err %04x", i);
-    }
+        // if ((i = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI, ":0.0" , NULL, 0)) != 0 ) {
+        if ((i = av_hwdevice_ctx_create(&hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI, "/dev/dri/renderD128", NULL, 0)) != 0) {
+            Fatal("codec: can't allocate HW video codec context err %04x", i);
+        }
 #endif
-    HwDeviceContext = av_buffer_ref(hw_device_ctx);
+        HwDeviceContext = av_buffer_ref(hw_device_ctx);
+    }
 
     if (!(decoder = calloc(1, sizeof(*decoder)))) {
         Error(_("video/cuvid: out of memory\n"));
         return NULL;
     }
 #ifdef VAAPI
-    VaDisplay = TO_VAAPI_DEVICE_CTX(HwDeviceContext)->display;
-    decoder->VaDisplay = VaDisplay;
+    if (HwDeviceContext) {
+        VaDisplay = TO_VAAPI_DEVICE_CTX(HwDeviceContext)->display;
+        decoder->VaDisplay = VaDisplay;
+    }
 #endif
     decoder->Window = VideoWindow;
     // decoder->VideoX = 0;  // done by calloc
@@ -1999,19 +2113,14 @@ static CuvidDecoder *CuvidNewHwDecoder(VideoStream * stream)
 }
 
 ///
-/// Cleanup CUVID.
+/// Reset the video surface ring buffer of a CUVID decoder.
 ///
 /// @param decoder  CUVID hw decoder
 ///
-static void CuvidCleanup(CuvidDecoder * decoder)
+static void CuvidResetSurfaceQueue(CuvidDecoder * decoder)
 {
     int i;
 
-    Debug(3, "Cuvid Clean up\n");
-
-    if (decoder->SurfaceFreeN || decoder->SurfaceUsedN) {
-        CuvidDestroySurfaces(decoder);
-    }
     //
     // reset video surface ring buffer
     //
@@ -2028,11 +2137,27 @@ static void CuvidCleanup(CuvidDecoder * decoder)
     decoder->FrameCounter = 0;
     decoder->FramesDisplayed = 0;
     decoder->StartCounter = 0;
+    decoder->LastAVDiff = 0;
     decoder->Closing = 0;
     decoder->PTS = AV_NOPTS_VALUE;
     VideoDeltaPTS = 0;
 }
 
+///
+/// Cleanup CUVID.
+///
+/// @param decoder  CUVID hw decoder
+///
+static void CuvidCleanup(CuvidDecoder * decoder)
+{
+    Debug(3, "Cuvid Clean up\n");
+
+    if (decoder->SurfaceFreeN || decoder->SurfaceUsedN) {
+        CuvidDestroySurfaces(decoder);
+    }
+    CuvidResetSurfaceQueue(decoder);
+}
+
 ///
 /// Destroy a CUVID decoder.
 ///
@@ -2077,6 +2202,7 @@ static void CuvidDelHwDecoder(CuvidDecoder * decoder)
                 cuCtxDestroy(decoder->cuda_ctx);
             }
 #endif
+            free(decoder->SoftBuffer);
             free(decoder);
             return;
         }
@@ -2108,6 +2234,20 @@ static int CuvidGlxInit( __attribute__((unused))
     return 1;
 }
 
+///
+/// Software decoder module initialize.
+///
+/// Uses the output of the CUVID module, the frames are decoded by
+/// the cpu and uploaded into the textures.
+///
+/// @param display_name x11 display name
+///
+static int SoftGlxInit(const char *display_name)
+{
+    VideoSoftDecode = 1;
+    return CuvidGlxInit(display_name);
+}
+
 ///
 /// CUVID cleanup.
 ///
@@ -2192,8 +2332,7 @@ void createTextureDst(CuvidDecoder * decoder, int anz, unsigned int size_x, unsi
 
     for (i = 0; i < anz; i++) {         // number of texture
         if (decoder->frames[i]) {
-            av_frame_free(&decoder->frames[i]);
-            decoder->frames[i] = NULL;
+            VideoFrameRelease(&decoder->frames[i]);
         }
         for (n = 0; n < 2; n++) {       // number of planes
             bool ok = true;
@@ -2214,7 +2353,7 @@ void createTextureDst(CuvidDecoder * decoder, int anz, unsigned int size_x, unsi
                 pl_tex_destroy(p->gpu, &decoder->pl_images[i].planes[n].texture);   // delete old texture
             }
 
-            if (p->has_dma_buf == 0) {
+            if (p->has_dma_buf == 0 || VideoSoftDecode) {
                 decoder->pl_images[i].planes[n].texture = pl_tex_create(p->gpu, &(struct pl_tex_params) {
                         .w = n == 0 ? size_x : size_x / 2,
                         .h = n == 0 ? size_y : size_y / 2,
@@ -2248,6 +2387,9 @@ void createTextureDst(CuvidDecoder * decoder, int anz, unsigned int size_x, unsi
                 Fatal(_("Unable to create placebo textures"));
             }
 #ifdef CUVID
+            if (VideoSoftDecode) {      // uploaded by generateSoftImage
+                continue;
+            }
             fd = dup(decoder->pl_images[i].planes[n].texture->shared_mem.handle.fd);
             CUDA_EXTERNAL_MEMORY_HANDLE_DESC ext_desc = {
                 .type = CU_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD,
@@ -2406,6 +2548,9 @@ void createTextureDst(CuvidDecoder * decoder, int anz, unsigned int size_x, unsi
             SDK_CHECK_ERROR_GL();
             // register this texture with CUDA
 #ifdef CUVID
+            if (VideoSoftDecode) {      // uploaded by generateSoftImage
+                continue;
+            }
             checkCudaErrors(cuGraphicsGLRegisterImage(&decoder->cu_res[i][n], decoder->gl_textures[i * 2 + n],
                     GL_TEXTURE_2D, CU_GRAPHICS_REGISTER_FLAGS_WRITE_DISCARD));
             checkCudaErrors(cuGraphicsMapResources(1, &decoder->cu_res[i][n], 0));
@@ -2496,6 +2641,130 @@ void generateVAAPIImage(CuvidDecoder * decoder, int index, const AVFrame * frame
 #endif
 #endif
 
+///
+/// Upload a software decoded frame into the textures of a surface.
+///
+/// The chroma planes are interleaved into the NV12/P010 layout of the
+/// textures, 10 bit samples are moved into the upper bits.
+///
+/// @param decoder  CUVID hw decoder
+/// @param index    surface index
+/// @param frame    software decoded YUV 4:2:0 frame
+/// @param image_width  width of video
+/// @param image_height height of video
+///
+static void generateSoftImage(CuvidDecoder * decoder, int index, const AVFrame * frame, int image_width,
+    int image_height)
+{
+    int x;
+    int y;
+    int size;
+    int luma_stride;
+    const uint8_t *luma;
+    uint8_t *chroma;
+#ifndef PLACEBO
+    GLenum type;
+#endif
+
+    size = (image_width * image_height + (image_width / 2) * (image_height / 2) * 2) * 2;
+    if (decoder->SoftBufferSize < size) {
+        free(decoder->SoftBuffer);
+        if (!(decoder->SoftBuffer = malloc(size))) {
+            decoder->SoftBufferSize = 0;
+            Error(_("video/soft: out of memory\n"));
+            return;
+        }
+        decoder->SoftBufferSize = size;
+    }
+
+    if (decoder->PixFmt == AV_PIX_FMT_NV12) {
+        luma = frame->data[0];          // 8 bit luma is used direct
+        luma_stride = frame->linesize[0];
+        chroma = decoder->SoftBuffer;
+        for (y = 0; y < image_height / 2; ++y) {
+            const uint8_t *u = frame->data[1] + y * frame->linesize[1];
+            const uint8_t *v = frame->data[2] + y * frame->linesize[2];
+            uint8_t *uv = chroma + y * image_width;
+
+            for (x = 0; x < image_width / 2; ++x) {
+                uv[x * 2 + 0] = u[x];
+                uv[x * 2 + 1] = v[x];
+            }
+        }
+    } else {
+        uint16_t *dst;
+
+        dst = (uint16_t *) decoder->SoftBuffer;
+        for (y = 0; y < image_height; ++y) {
+            const uint16_t *src = (const uint16_t *)(frame->data[0] + y * frame->linesize[0]);
+
+            for (x = 0; x < image_width; ++x) {
+                *dst++ = src[x] << 6;
+            }
+        }
+        for (y = 0; y < image_height / 2; ++y) {
+            const uint16_t *u = (const uint16_t *)(frame->data[1] + y * frame->linesize[1]);
+            const uint16_t *v = (const uint16_t *)(frame->data[2] + y * frame->linesize[2]);
+
+            for (x = 0; x < image_width / 2; ++x) {
+                *dst++ = u[x] << 6;
+                *dst++ = v[x] << 6;
+            }
+        }
+        luma = decoder->SoftBuffer;
+        luma_stride = image_width;
+        chroma = decoder->SoftBuffer + image_width * image_height * 2;
+    }
+
+#ifdef PLACEBO
+    VideoThreadLock();
+    if (!pl_tex_upload(p->gpu, &(struct pl_tex_transfer_params) {
+                .tex = decoder->pl_images[index].planes[0].texture,
+                .stride_w = luma_stride,
+                .stride_h = image_height,
+                .ptr = (void *)luma,
+                .rc.x1 = image_width,
+                .rc.y1 = image_height,
+                .rc.z1 = 0,
+            })
+        || !pl_tex_upload(p->gpu, &(struct pl_tex_transfer_params) {
+                .tex = decoder->pl_images[index].planes[1].texture,
+                .stride_w = image_width / 2,
+                .stride_h = image_height / 2,
+                .ptr = chroma,
+                .rc.x1 = image_width / 2,
+                .rc.y1 = image_height / 2,
+                .rc.z1 = 0,
+            })) {
+        Error(_("video/soft: texture upload failed\n"));
+    }
+    VideoThreadUnlock();
+#else
+    type = decoder->PixFmt == AV_PIX_FMT_NV12 ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+#ifdef CUVID
+    glXMakeCurrent(XlibDisplay, VideoWindow, glxSharedContext);
+    GlxCheck();
+#else
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglSharedContext);
+    EglCheck();
+#endif
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, luma_stride);
+    glBindTexture(GL_TEXTURE_2D, decoder->gl_textures[index * 2 + 0]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image_width, image_height, GL_RED, type, luma);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image_width / 2);
+    glBindTexture(GL_TEXTURE_2D, decoder->gl_textures[index * 2 + 1]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image_width / 2, image_height / 2, GL_RG, type, chroma);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GlxCheck();
+    glFinish();                         // textures are used by the display context
+#ifdef VAAPI
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
+#endif
+}
+
 ///
 /// Configure CUVID for new video format.
 ///
@@ -2530,6 +2799,37 @@ static unsigned CuvidGetVideoSurface(CuvidDecoder * decoder, const AVCodecContex
     return CuvidGetVideoSurface0(decoder);
 }
 
+///
+/// Keep the surfaces of the decoder for a new stream.
+///
+/// Surfaces are only recreated, if size or pixel format of the new
+/// stream differ, otherwise the queued frames are released.
+///
+/// @param decoder  CUVID hw decoder
+/// @param video_ctx    ffmpeg video codec context of new stream
+/// @param pix_fmt  surface pixel format of the old stream
+///
+/// @returns true if the surfaces are kept.
+///
+static int CuvidKeepSurfaces(CuvidDecoder * decoder, const AVCodecContext * video_ctx, enum AVPixelFormat pix_fmt)
+{
+    if ((!decoder->SurfaceFreeN && !decoder->SurfaceUsedN) || decoder->InputWidth != video_ctx->width
+        || decoder->InputHeight != video_ctx->height || decoder->PixFmt != pix_fmt) {
+        return 0;
+    }
+    Debug(3, "video: keep %d surfaces %dx%d\n", decoder->SurfacesNeeded, decoder->InputWidth, decoder->InputHeight);
+
+    while (decoder->SurfaceUsedN) {
+        CuvidReleaseSurface(decoder, decoder->SurfacesUsed[0]);
+    }
+    CuvidResetSurfaceQueue(decoder);
+    decoder->InputAspect = video_ctx->sample_aspect_ratio;
+    decoder->Interlaced = 0;
+    CuvidUpdateOutput(decoder);         // update aspect/scaling
+
+    return 1;
+}
+
 #if defined (VAAPI) || defined (YADIF)
 static void CuvidSyncRenderFrame(CuvidDecoder * decoder, const AVCodecContext * video_ctx, const AVFrame * frame);
 
@@ -2538,7 +2838,7 @@ int push_filters(AVCodecContext * dec_ctx, CuvidDecoder * decoder, AVFrame * fra
 {
     
     int ret, i = 0;
-    AVFrame *filt_frame = av_frame_alloc();
+    AVFrame *filt_frame = VideoFrameGet();
 
     /* push the decoded frame into the filtergraph */
     if (av_buffersrc_add_frame_flags(decoder->buffersrc_ctx, frame, AV_BUFFERSRC_FLAG_KEEP_REF) < 0) {
@@ -2552,11 +2852,11 @@ int push_filters(AVCodecContext * dec_ctx, CuvidDecoder * decoder, AVFrame * fra
         decoder->Interlaced = 0;
  //        printf("vaapideint video:new  %#012" PRIx64 " old %#012" PRIx64 "\n",filt_frame->pts,frame->pts);
         CuvidSyncRenderFrame(decoder, dec_ctx, filt_frame);
-        filt_frame = av_frame_alloc();  // get new frame
+        filt_frame = VideoFrameGet();   // get new frame
 
     }
-    av_frame_free(&filt_frame);
-    av_frame_free(&frame);
+    VideoFrameRelease(&filt_frame);
+    VideoFrameRelease(&frame);
     return ret;
 }
 
@@ -2686,6 +2986,7 @@ static enum AVPixelFormat Cuvid_get_format(CuvidDecoder * decoder, AVCodecContex
     const enum AVPixelFormat *fmt)
 {
     const enum AVPixelFormat *fmt_idx;
+    enum AVPixelFormat pix_fmt;
     int bitformat16 = 0, deint = 0;
 
     VideoDecoder *ist = video_ctx->opaque;
@@ -2738,6 +3039,7 @@ static enum AVPixelFormat Cuvid_get_format(CuvidDecoder * decoder, AVCodecContex
 
         //  Check image, format, size
         //
+        pix_fmt = decoder->PixFmt;
         if (bitformat16) {
             decoder->PixFmt = AV_PIX_FMT_YUV420P;   // 10 Bit Planar
             ist->hwaccel_output_format = AV_PIX_FMT_YUV420P;
@@ -2753,13 +3055,15 @@ static enum AVPixelFormat Cuvid_get_format(CuvidDecoder * decoder, AVCodecContex
 #ifdef PLACEBO
             VideoThreadLock();
 #endif
-            CuvidCleanup(decoder);
-            decoder->InputAspect = video_ctx->sample_aspect_ratio;
-            decoder->InputWidth = video_ctx->width;
-            decoder->InputHeight = video_ctx->height;
-            decoder->Interlaced = 0;
-            decoder->SurfacesNeeded = VIDEO_SURFACES_MAX + 1;
-            CuvidSetupOutput(decoder);
+            if (!CuvidKeepSurfaces(decoder, video_ctx, pix_fmt)) {
+                CuvidCleanup(decoder);
+                decoder->InputAspect = video_ctx->sample_aspect_ratio;
+                decoder->InputWidth = video_ctx->width;
+                decoder->InputHeight = video_ctx->height;
+                decoder->Interlaced = 0;
+                decoder->SurfacesNeeded = VIDEO_SURFACES_MAX + 1;
+                CuvidSetupOutput(decoder);
+            }
 #ifdef PLACEBO
             VideoThreadUnlock();
             // dont show first frame
@@ -2795,6 +3099,70 @@ static enum AVPixelFormat Cuvid_get_format(CuvidDecoder * decoder, AVCodecContex
     return *fmt_idx;
 }
 
+///
+/// Callback to negotiate the pixel format of the software decoder.
+///
+/// @param decoder  CUVID hw decoder
+/// @param video_ctx    ffmpeg video codec context
+/// @param fmt  is the list of formats which are supported by the codec,
+///     it is terminated by -1 as 0 is a valid format, the
+///     formats are ordered by quality.
+///
+static enum AVPixelFormat Soft_get_format(CuvidDecoder * decoder, AVCodecContext * video_ctx,
+    const enum AVPixelFormat *fmt)
+{
+    const enum AVPixelFormat *fmt_idx;
+    enum AVPixelFormat pix_fmt;
+    VideoDecoder *ist = video_ctx->opaque;
+
+    Debug(3, "%s: codec %d fmts:\n", __FUNCTION__, video_ctx->codec_id);
+    for (fmt_idx = fmt; *fmt_idx != AV_PIX_FMT_NONE; fmt_idx++) {
+        Debug(3, "\t%#010x %s\n", *fmt_idx, av_get_pix_fmt_name(*fmt_idx));
+        if (*fmt_idx == AV_PIX_FMT_YUV420P || *fmt_idx == AV_PIX_FMT_YUVJ420P
+            || *fmt_idx == AV_PIX_FMT_YUV420P10LE) {
+            break;
+        }
+    }
+    if (*fmt_idx == AV_PIX_FMT_NONE) {  // fe. 4:2:2, only this stream fails
+        Error(_("video/soft: no valid pixfmt found\n"));
+        return AV_PIX_FMT_NONE;
+    }
+    decoder->newchannel = 1;
+    if (ist->GetFormatDone) {
+        return *fmt_idx;
+    }
+    ist->GetFormatDone = 1;
+
+    Debug(3, "video/soft: create decoder %s %dx%d old %d %d\n", av_get_pix_fmt_name(*fmt_idx), video_ctx->width,
+        video_ctx->height, decoder->InputWidth, decoder->InputHeight);
+
+    // textures use the NV12/P010 layout of the hw decoders
+    pix_fmt = decoder->PixFmt;
+    decoder->PixFmt = *fmt_idx == AV_PIX_FMT_YUV420P10LE ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_NV12;
+    ist->hwaccel_output_format = *fmt_idx;
+
+    if (decoder->TrickSpeed == 0) {
+#ifdef PLACEBO
+        VideoThreadLock();
+#endif
+        if (!CuvidKeepSurfaces(decoder, video_ctx, pix_fmt)) {
+            CuvidCleanup(decoder);
+            decoder->InputAspect = video_ctx->sample_aspect_ratio;
+            decoder->InputWidth = video_ctx->width;
+            decoder->InputHeight = video_ctx->height;
+            decoder->Interlaced = 0;
+            decoder->SurfacesNeeded = VIDEO_SURFACES_MAX + 1;
+            CuvidSetupOutput(decoder);
+        }
+#ifdef PLACEBO
+        VideoThreadUnlock();
+#endif
+    }
+    decoder->InputAspect = video_ctx->sample_aspect_ratio;
+    ist->filter = 0;                    // no hw deinterlacer
+    return *fmt_idx;
+}
+
 #ifdef USE_GRAB
 #ifdef PLACEBO
 int get_RGB(CuvidDecoder * decoder, struct pl_overlay *ovl)
@@ -3191,7 +3559,7 @@ static void CuvidRenderFrame(CuvidDecoder * decoder, const AVCodecContext * vide
     enum AVColorSpace color;
 
     if (decoder->Closing == 1) {
-        av_frame_free(&frame);
+        VideoFrameRelease(&frame);
         return;
     }
 
@@ -3231,6 +3599,24 @@ static void CuvidRenderFrame(CuvidDecoder * decoder, const AVCodecContext * vide
     //  Copy data from frame to image
     //
 
+    if (VideoSoftDecode && !frame->hw_frames_ctx) {   // software decoder, upload to textures
+        decoder->ColorSpace = color;    // save colorspace
+        decoder->trc = frame->color_trc;
+        decoder->color_primaries = frame->color_primaries;
+
+        surface = CuvidGetVideoSurface0(decoder);
+        if (surface == -1) {            // no free surfaces
+            Debug(3, "no more surfaces\n");
+            VideoFrameRelease(&frame);
+            return;
+        }
+        generateSoftImage(decoder, surface, frame, decoder->InputWidth, decoder->InputHeight);
+
+        CuvidQueueVideoSurface(decoder, surface, 1);
+        decoder->frames[surface] = frame;
+        return;
+    }
+
     if (video_ctx->pix_fmt == PIXEL_FORMAT) {
 
         int w = decoder->InputWidth;
@@ -3244,7 +3630,7 @@ static void CuvidRenderFrame(CuvidDecoder * decoder, const AVCodecContext * vide
 
         if (surface == -1) {            // no free surfaces
             Debug(3, "no more surfaces\n");
-            av_frame_free(&frame);
+            VideoFrameRelease(&frame);
             return;
         }
 #if 0
@@ -3261,7 +3647,7 @@ static void CuvidRenderFrame(CuvidDecoder * decoder, const AVCodecContext * vide
 
             VideoThreadLock();
             vaSyncSurface(decoder->VaDisplay, (unsigned int)frame->data[3]);
-            output = av_frame_alloc();
+            output = VideoFrameGet();
             av_hwframe_transfer_data(output, frame, 0);
             av_frame_copy_props(output, frame);
             // printf("Save Surface ID %d %p %p\n",surface,decoder->pl_images[surface].planes[0].texture,decoder->pl_images[surface].planes[1].texture);
@@ -3283,7 +3669,7 @@ static void CuvidRenderFrame(CuvidDecoder * decoder, const AVCodecContext * vide
                     .rc.y1 = h / 2,
                     .rc.z1 = 0,
                 });
-            av_frame_free(&output);
+            VideoFrameRelease(&output);
             VideoThreadUnlock();
         }
 #else
@@ -3317,6 +3703,9 @@ static void *CuvidGetHwAccelContext(CuvidDecoder * decoder)
     Debug(3, "Initializing cuvid hwaccel thread ID:%ld\n", (long int)syscall(186));
     // turn NULL;
 #ifdef CUVID
+    if (VideoSoftDecode) {              // no cuda needed for upload
+        return NULL;
+    }
     if (decoder->cuda_ctx) {
         Debug(3, "schon passiert\n");
         return NULL;
@@ -3382,6 +3771,9 @@ static void CuvidAdvanceDecoderFrame(CuvidDecoder * decoder)
         decoder->SurfaceRead = (decoder->SurfaceRead + 1) % VIDEO_SURFACES_MAX;
         atomic_dec(&decoder->SurfacesFilled);
         decoder->SurfaceField = !decoder->Interlaced;
+#ifdef USE_VIDEO_THREAD
+        VideoDecoderSignal(0);          // surface free for decoder
+#endif
         return;
     }
     // next field
@@ -3870,6 +4262,15 @@ static void CuvidDisplayFrame(void)
             continue;
         }
         valid_frame = 1;
+        if (!i && VideoZapStart) {      // first frame after channel switch
+            uint32_t ms;
+
+            ms = GetMsTicks() - VideoZapStart;
+            VideoZapStart = 0;
+            VideoZapTotal += ms;
+            ++VideoZapCount;
+            Info(_("video: channel switch %dms to first frame, average %dms\n"), ms, VideoZapTotal / VideoZapCount);
+        }
 #ifdef PLACEBO
         if (OsdShown == 1) {            // New OSD opened
             pthread_mutex_lock(&OSDMutex);
@@ -4059,6 +4460,7 @@ static void CuvidSetClosing(CuvidDecoder * decoder)
 static void CuvidResetStart(CuvidDecoder * decoder)
 {
     decoder->StartCounter = 0;
+    decoder->LastAVDiff = 0;
 }
 
 ///
@@ -4094,6 +4496,22 @@ void CuvidGetStats(CuvidDecoder * decoder, int *missed, int *duped, int *dropped
     *frametime = decoder->Frameproc;
 }
 
+///
+/// Get CUVID decoder audio/video difference.
+///
+/// @param decoder  CUVID decoder
+///
+/// @returns smoothed video - audio difference in ms, negative if video
+/// is late, 0 if not synced to audio.
+///
+static int CuvidGetAVDiff(const CuvidDecoder * decoder)
+{
+    if (!decoder->SyncOnAudio || decoder->TrickSpeed) {
+        return 0;
+    }
+    return decoder->LastAVDiff / 90;
+}
+
 ///
 /// Sync decoder output to audio.
 ///
@@ -4103,6 +4521,8 @@ void CuvidGetStats(CuvidDecoder * decoder, int *missed, int *duped, int *dropped
 /// video>audio slow down video by duplicating frames
 /// video<audio speed up video by skipping frames
 /// soft-start  show every second frame
+/// master-sync only big differences are handled here, the audio is
+///     resampled to follow the video
 ///
 /// @param decoder  CUVID hw decoder
 ///
@@ -4166,6 +4586,10 @@ static void CuvidSyncDecoder(CuvidDecoder * decoder)
         diff = video_clock - audio_clock - VideoAudioDelay;
         diff = (decoder->LastAVDiff + diff) / 2;
         decoder->LastAVDiff = diff;
+        if (VideoMasterSync) {
+            VideoMasterDiff = diff;
+            VideoMasterTick = GetMsTicks();
+        }
 
         // if (CuvidDecoderN) {
         // CuvidDecoders[0]->Frameproc = (float)(diff / 90);
@@ -4180,6 +4604,8 @@ static void CuvidSyncDecoder(CuvidDecoder * decoder)
             // decoder->SyncCounter = 1;
             // usleep(10);
             // goto out;
+        } else if (VideoMasterSync && abs(diff) <= 100 * 90) {
+            // audio is resampled to follow video
         } else if (diff > 100 * 90) {
             // FIXME: this quicker sync step, did not work with new code!
             err = CuvidMessage(4, "video: slow down video, duping frame %d\n", diff / 90);
@@ -4380,14 +4806,10 @@ static void CuvidDisplayHandlerThread(void)
         filled = atomic_read(&decoder->SurfacesFilled);
         //if (filled <= 1 +  2 * decoder->Interlaced) {
         if (filled < 4) {
-            // FIXME: hot polling
             // fetch+decode or reopen
             allfull = 0;
             err = VideoDecodeInput(decoder->Stream);
         } else {
-
-            usleep(1000);
-
             err = VideoPollInput(decoder->Stream);
         }
         // decoder can be invalid here
@@ -4400,25 +4822,16 @@ static void CuvidDisplayHandlerThread(void)
                     decoder->Closing = -1;
                 }
             }
-
-            usleep(1000);
-
             continue;
         }
         decoded = 1;
     }
 
-
-
-    if (!decoded) {                     // nothing decoded, sleep
-        // FIXME: sleep on wakeup
-        usleep(1 * 1000);
+    if (!decoded) {                     // nothing decoded, sleep on wakeup
+        // new packet, free surface or command
+        VideoDecoderWait(20);
     }
 
-
-    usleep(1000);
-
-
     // all decoder buffers are full
     // and display is not preempted
     // speed up filling display queue, wait on display queue empty
@@ -4483,6 +4896,7 @@ static const VideoModule CuvidModule = {
     .GrabOutput = CuvidGrabOutputSurface,
     .GetStats = (void (*const)(VideoHwDecoder *, int *, int *, int *,
             int *, float *))CuvidGetStats,
+    .GetAVDiff = (int (*const)(const VideoHwDecoder *))CuvidGetAVDiff,
     .SetBackground = CuvidSetBackground,
     .SetVideoMode = CuvidSetVideoMode,
 
@@ -4499,6 +4913,38 @@ static const VideoModule CuvidModule = {
     .Init = CuvidGlxInit,
 };
 
+///
+/// Software decoder module, cpu decode with CUVID output.
+///
+static const VideoModule SoftModule = {
+    .Name = "soft",
+    .Enabled = 0,                       // only selected by name
+    .NewHwDecoder = (VideoHwDecoder * (*const)(VideoStream *)) CuvidNewHwDecoder,
+    .DelHwDecoder = (void (*const) (VideoHwDecoder *))CuvidDelHwDecoder,
+    .GetSurface = (unsigned (*const) (VideoHwDecoder *, const AVCodecContext *))CuvidGetVideoSurface,
+    .ReleaseSurface = (void (*const) (VideoHwDecoder *, unsigned))CuvidReleaseSurface,
+    .get_format = (enum AVPixelFormat(*const) (VideoHwDecoder *,
+            AVCodecContext *, const enum AVPixelFormat *))Soft_get_format,
+    .RenderFrame = (void (*const) (VideoHwDecoder *,
+            const AVCodecContext *, const AVFrame *))CuvidSyncRenderFrame,
+    .GetHwAccelContext = (void *(*const)(VideoHwDecoder *))CuvidGetHwAccelContext,
+    .SetClock = (void (*const)(VideoHwDecoder *, int64_t))CuvidSetClock,
+    .GetClock = (int64_t(*const)(const VideoHwDecoder *))CuvidGetClock,
+    .SetClosing = (void (*const)(const VideoHwDecoder *))CuvidSetClosing,
+    .ResetStart = (void (*const)(const VideoHwDecoder *))CuvidResetStart,
+    .SetTrickSpeed = (void (*const)(const VideoHwDecoder *, int))CuvidSetTrickSpeed,
+    .GrabOutput = CuvidGrabOutputSurface,
+    .GetStats = (void (*const)(VideoHwDecoder *, int *, int *, int *,
+            int *, float *))CuvidGetStats,
+    .GetAVDiff = (int (*const)(const VideoHwDecoder *))CuvidGetAVDiff,
+    .SetBackground = CuvidSetBackground,
+    .SetVideoMode = CuvidSetVideoMode,
+
+    .DisplayHandlerThread = CuvidDisplayHandlerThread,
+    .Exit = CuvidExit,
+    .Init = SoftGlxInit,
+};
+
 #endif
 
 //----------------------------------------------------------------------------
@@ -4984,6 +5430,96 @@ void VideoSetVideoEventCallback(void (*videoEventCallback)(void))
 
 #ifdef USE_VIDEO_THREAD
 
+///
+/// Get monotonic time in us.
+///
+static uint64_t VideoGetUsTicks(void)
+{
+    struct timespec tspec;
+
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t) tspec.tv_sec * 1000 * 1000 + tspec.tv_nsec / 1000;
+}
+
+///
+/// Signal an event to the video decode thread.
+///
+/// Events are new packets in the video stream, free surfaces and
+/// close/clear commands.
+///
+/// @param packet   event is a new video packet
+///
+static void VideoDecoderSignal(int packet)
+{
+    pthread_mutex_lock(&VideoMutex);
+    if (packet && !VideoDecoderEventTime) {
+        VideoDecoderEventTime = VideoGetUsTicks();
+    }
+    VideoDecoderEvent = 1;
+    pthread_cond_signal(&VideoWakeupCond);
+    pthread_mutex_unlock(&VideoMutex);
+}
+
+///
+/// Wait for the next event of the video decode thread.
+///
+/// Returns at once, if an event is already pending.  The timeout keeps
+/// commands working, which have no event.
+///
+/// @param timeout  maximal time to wait in ms
+///
+void VideoDecoderWait(int timeout)
+{
+    struct timespec abstime;
+    uint64_t tick;
+
+    pthread_mutex_lock(&VideoMutex);
+    if (!VideoDecoderEvent) {
+        VideoDecoderEventTime = 0;      // nothing pending
+        clock_gettime(CLOCK_MONOTONIC, &abstime);
+        abstime.tv_nsec += timeout * 1000 * 1000;
+        abstime.tv_sec += abstime.tv_nsec / (1000 * 1000 * 1000);
+        abstime.tv_nsec %= 1000 * 1000 * 1000;
+        while (!VideoDecoderEvent) {
+            if (pthread_cond_timedwait(&VideoWakeupCond, &VideoMutex, &abstime) == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+    VideoDecoderEvent = 0;
+
+    tick = VideoGetUsTicks();
+    ++VideoDecoderWakeups;
+    if (VideoDecoderEventTime) {        // decode start latency of packet
+        uint32_t latency;
+
+        latency = tick - VideoDecoderEventTime;
+        VideoDecoderEventTime = 0;
+        ++VideoDecoderLatencies;
+        VideoDecoderLatencySum += latency;
+        if (latency > VideoDecoderLatencyMax) {
+            VideoDecoderLatencyMax = latency;
+        }
+    }
+    pthread_mutex_unlock(&VideoMutex);
+
+    if (tick - VideoDecoderReportTime >= 10 * 1000 * 1000) {
+        if (VideoDecoderReportTime) {
+            VideoDecoderWakeupRate = VideoDecoderWakeups * 1000 * 1000ULL / (tick - VideoDecoderReportTime);
+            VideoDecoderLatencyAvg =
+                VideoDecoderLatencies ? (int)(VideoDecoderLatencySum / VideoDecoderLatencies) : 0;
+            VideoDecoderLatencyPeak = VideoDecoderLatencyMax;
+            Debug(3, "video: %d decoder wakeups/s, decode start latency %dus avg %dus max, %d frame pool misses\n",
+                VideoDecoderWakeupRate, VideoDecoderLatencyAvg, VideoDecoderLatencyPeak, VideoFramePoolMisses);
+        }
+        VideoDecoderReportTime = tick;
+        VideoDecoderWakeups = 0;
+        VideoDecoderLatencies = 0;
+        VideoDecoderLatencySum = 0;
+        VideoDecoderLatencyMax = 0;
+    }
+}
+
 #ifdef PLACEBO
 
 void pl_log_intern(void *stream, enum pl_log_level level, const char *msg)
@@ -5193,6 +5729,7 @@ static void *VideoHandlerThread(void *dummy)
 ///
 static void VideoThreadInit(void)
 {
+    pthread_condattr_t condattr;
 
 #ifndef PLACEBO
 #ifdef CUVID
@@ -5204,7 +5741,11 @@ static void VideoThreadInit(void)
     pthread_mutex_init(&VideoMutex, NULL);
     pthread_mutex_init(&VideoLockMutex, NULL);
     pthread_mutex_init(&OSDMutex, NULL);
-    pthread_cond_init(&VideoWakeupCond, NULL);
+    // decode thread waits with monotonic timeouts
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&VideoWakeupCond, &condattr);
+    pthread_condattr_destroy(&condattr);
     pthread_create(&VideoThread, NULL, VideoDisplayHandlerThread, NULL);
  
     pthread_create(&VideoDisplayThread, NULL, VideoHandlerThread, NULL);
@@ -5277,6 +5818,7 @@ void VideoDisplayWakeup(void)
     if (!VideoThread) {                 // start video thread, if needed
         VideoThreadInit();
     }
+    VideoDecoderSignal(1);
 }
 
 #endif
@@ -5293,6 +5835,7 @@ void VideoDisplayWakeup(void)
 static const VideoModule *VideoModules[] = {
 
     &CuvidModule,
+    &SoftModule,
     &NoopModule
 };
 
@@ -5370,6 +5913,50 @@ void VideoReleaseSurface(VideoHwDecoder * hw_decoder, unsigned surface)
     VideoUsedModule->ReleaseSurface(hw_decoder, surface);
 }
 
+///
+/// Prepare the hw decoder for a warm codec context.
+///
+/// A reused context doesn't call get_format for a stream with unchanged
+/// format, do what get_format does for a new channel.
+///
+/// @param hw_decoder   video hardware decoder
+///
+void VideoWarmStart(VideoHwDecoder * hw_decoder)
+{
+    hw_decoder->Cuvid.newchannel = 1;   // don't show first frame
+}
+
+///
+/// Release the deinterlace filter of a parked codec context.
+///
+/// The filter graph holds frames and the hw frames context of the old
+/// stream, it is build again for the next stream.
+///
+/// @param hw_decoder   video hardware decoder
+///
+void VideoFilterRelease(VideoHwDecoder * hw_decoder)
+{
+#if defined(YADIF) || defined (VAAPI)
+    avfilter_graph_free(&hw_decoder->Cuvid.filter_graph);
+#else
+    (void)hw_decoder;
+#endif
+}
+
+///
+/// Start measuring the channel switch.
+///
+/// Called when the decoder of the new stream is opened, cold or warm.
+/// The time from the channel switch to its first frame is reported.
+///
+void VideoZapStarted(void)
+{
+    if (VideoSwitch != VideoSwitchSeen) {
+        VideoSwitchSeen = VideoSwitch;
+        VideoZapStart = VideoSwitch;
+    }
+}
+
 ///
 /// Callback to negotiate the PixelFormat.
 ///
@@ -5400,6 +5987,9 @@ enum AVPixelFormat Video_get_format(VideoHwDecoder * hw_decoder, AVCodecContext
 ///
 /// Display a ffmpeg frame
 ///
+/// The frame from VideoFrameGet is owned by the video module now, it
+/// is given back to the frame pool when its surface is released.
+///
 /// @param hw_decoder   video hardware decoder
 /// @param video_ctx    ffmpeg video codec context
 /// @param frame    frame to display
@@ -5653,6 +6243,41 @@ void VideoGetStats(VideoHwDecoder * hw_decoder, int *missed, int *duped, int *dr
     VideoUsedModule->GetStats(hw_decoder, missed, duped, dropped, counter, frametime);
 }
 
+///
+/// Get decode thread statistics of the last 10 seconds.
+///
+/// @param[out] wakeups     decode thread wakeups per second
+/// @param[out] latency     average decode start latency in us
+/// @param[out] latency_max maximal decode start latency in us
+///
+void VideoGetDecoderStats(int *wakeups, int *latency, int *latency_max)
+{
+#ifdef USE_VIDEO_THREAD
+    *wakeups = VideoDecoderWakeupRate;
+    *latency = VideoDecoderLatencyAvg;
+    *latency_max = VideoDecoderLatencyPeak;
+#else
+    *wakeups = 0;
+    *latency = 0;
+    *latency_max = 0;
+#endif
+}
+
+///
+/// Get audio/video difference.
+///
+/// @param hw_decoder   video hardware decoder
+///
+/// @returns video - audio difference in ms, negative if video is late.
+///
+int VideoGetAVDiff(const VideoHwDecoder * hw_decoder)
+{
+    if (hw_decoder && VideoUsedModule->GetAVDiff) {
+        return VideoUsedModule->GetAVDiff(hw_decoder);
+    }
+    return 0;
+}
+
 ///
 /// Get decoder video stream size.
 ///
@@ -5670,7 +6295,7 @@ void VideoGetVideoSize(VideoHwDecoder * hw_decoder, int *width, int *height, int
     *aspect_den = 9;
     // FIXME: test to check if working, than make module function
 
-    if (VideoUsedModule == &CuvidModule) {
+    if (VideoUsedModule == &CuvidModule || VideoUsedModule == &SoftModule) {
         *width = hw_decoder->Cuvid.InputWidth;
         *height = hw_decoder->Cuvid.InputHeight;
         av_reduce(aspect_num, aspect_den, hw_decoder->Cuvid.InputWidth * hw_decoder->Cuvid.InputAspect.num,
@@ -5984,6 +6609,38 @@ void VideoSetSoftStartSync(int onoff)
     VideoSoftStartSync = onoff;
 }
 
+///
+/// Set video master audio/video sync.
+///
+/// The display drives the clock, audio is resampled to follow video.
+///
+/// @param onoff    enable / disable the video master sync.
+///
+void VideoSetMasterSync(int onoff)
+{
+    VideoMasterSync = onoff;
+}
+
+///
+/// Get video master audio/video difference.
+///
+/// @param[out] diff    smoothed video - audio difference in pts
+///
+/// @returns true if video master sync is active and the difference is
+/// fresh, false if audio must run on its own clock.
+///
+int VideoGetMasterSyncDiff(int *diff)
+{
+    uint32_t tick;
+
+    tick = VideoMasterTick;
+    if (!VideoMasterSync || !tick || GetMsTicks() - tick > 500) {
+        return 0;
+    }
+    *diff = VideoMasterDiff;
+    return 1;
+}
+
 ///
 /// Set show black picture during channel switch.
 ///
@@ -6087,7 +6744,7 @@ void VideoSetOutputPosition(VideoHwDecoder * hw_decoder, int x, int y, int width
 
     // FIXME: add function to module class
 
-    if (VideoUsedModule == &CuvidModule) {
+    if (VideoUsedModule == &CuvidModule || VideoUsedModule == &SoftModule) {
         // check values to be able to avoid
         // interfering with the video thread if possible
 
@@ -6571,6 +7228,7 @@ void VideoInit(const char *display_name)
 
     Debug(3, "video: window prepared\n");
 #endif
+    VideoFramePoolInit();
     //
     //  prepare hardware decoder
     //
@@ -6632,6 +7290,7 @@ void VideoExit(void)
 #ifdef USE_VIDEO_THREAD
     VideoThreadExit();                  // destroy all mutexes
 #endif
+    VideoFramePoolExit();
 
 #ifdef USE_GLX
     if (EglEnabled) {
@@ -64,6 +64,15 @@ extern void VideoReleaseSurface(VideoHwDecoder *, unsigned);
 /// Callback to negotiate the PixelFormat.
 extern enum AVPixelFormat Video_get_format(VideoHwDecoder *, AVCodecContext *, const enum AVPixelFormat *);
 
+/// Start measuring the channel switch.
+extern void VideoZapStarted(void);
+
+/// Prepare the hw decoder for a warm codec context.
+extern void VideoWarmStart(VideoHwDecoder *);
+
+/// Release the deinterlace filter of a parked codec context.
+extern void VideoFilterRelease(VideoHwDecoder *);
+
 /// Render a ffmpeg frame.
 extern void VideoRenderFrame(VideoHwDecoder *, const AVCodecContext *, const AVFrame *);
 
@@ -86,6 +95,15 @@ extern void VideoPollEvent(void);
 /// Wakeup display handler.
 extern void VideoDisplayWakeup(void);
 
+/// Wait for packet, free surface or command in decode thread.
+extern void VideoDecoderWait(int);
+
+/// Get a decoder frame from the frame pool.
+extern AVFrame *VideoFrameGet(void);
+
+/// Give a decoder frame back to the frame pool.
+extern void VideoFrameRelease(AVFrame **);
+
 /// Set video device.
 extern void VideoSetDevice(const char *);
 
@@ -101,6 +119,12 @@ extern void VideoSet60HzMode(int);
 /// Set soft start audio/video sync.
 extern void VideoSetSoftStartSync(int);
 
+/// Set video master audio/video sync.
+extern void VideoSetMasterSync(int);
+
+/// Get video master audio/video difference.
+extern int VideoGetMasterSyncDiff(int *);
+
 /// Set show black picture during channel switch.
 extern void VideoSetBlackPicture(int);
 
@@ -221,6 +245,12 @@ extern uint8_t *VideoGrabService(int *, int *, int *);
 /// Get decoder statistics.
 extern void VideoGetStats(VideoHwDecoder *, int *, int *, int *, int *, float *);
 
+/// Get decode thread statistics.
+extern void VideoGetDecoderStats(int *, int *, int *);
+
+/// Get audio/video difference in ms.
+extern int VideoGetAVDiff(const VideoHwDecoder *);
+
 /// Get video stream size
 extern void VideoGetVideoSize(VideoHwDecoder *, int *, int *, int *, int *);
 